@@ -0,0 +1,602 @@
+// Hyperbolic Rogue -- Archipelago client I/O
+// Copyright (C) 2011-2019 Zeno Rogue
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+/** \file archipelago-io.cpp
+ *  \brief keeps the Archipelago client traffic off the game loop
+ *
+ *  The game never calls the ap:: client directly. Outbound events (location checks, goal)
+ *  are put into a single-producer single-consumer ring, which a dedicated I/O thread
+ *  delivers to the client. The slot data the game queries synchronously (lands needed for
+ *  Hell, unlocked lands, whether a restart is needed) is read by the same thread and cached.
+ *  All calls into the client are serialized by client_lock.
+ *
+ *  Every location is checked at most once: the game thread drops the checks it has already
+ *  posted, and the I/O thread coalesces the rest into batches sent every batch_ms. Each check
+ *  is written to a small journal when it is queued and again when it is sent, so the checks
+ *  made while the connection was down (or in a session which ended before they were sent)
+ *  are sent again on reconnect. The journal and the checked locations belong to the slot which the
+ *  client reported with set_slot(); without a slot, nothing is journaled.
+ *
+ *  Once the client has been enabled, the checks are taken (and journaled) even while it is not,
+ *  until a game is started without it; but the game only sees Archipelago as enabled while the client says so.
+ */
+
+#include "hyper.h"
+namespace hr {
+
+EX namespace apq {
+
+#if HDR
+enum eEventKind { evYendor, evTreasure, evSlot };
+struct ap_event { eEventKind kind; int arg; long long posted; };
+
+/** where the events go; the real client, or the loopback stand-in used for testing */
+struct client {
+  virtual bool enabled() = 0;
+  virtual bool needs_restart() = 0;
+  virtual int lands_for_hell() = 0;
+  virtual bool land_unlocked(eLand l) = 0;
+  virtual void send(const vector<ap_event>& batch) = 0;
+  virtual ~client() {}
+  };
+#endif
+
+#if CAP_THREAD
+template<class T> using shared = std::atomic<T>;
+#else
+template<class T> using shared = T;
+#endif
+
+long long now_us() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+struct ap_client : client {
+  bool enabled() override { return ap::apIsEnabled(); }
+  bool needs_restart() override { return ap::needsRestart(); }
+  int lands_for_hell() override { return ap::getLandsForHell(); }
+  bool land_unlocked(eLand l) override { return ap::landUnlocked(l); }
+  void send(const vector<ap_event>& batch) override {
+    for(auto& e: batch)
+      if(e.kind == evYendor) ap::sendYendor();
+      else ap::trySendTreasure(eItem(e.arg));
+    }
+  };
+
+/** a local stand-in for the server: every land is unlocked, and every batch takes `latency_ms` */
+struct loopback_client : client {
+  int latency_ms;
+  bool online = true;
+  vector<ap_event> received;
+  loopback_client(int l) : latency_ms(l) {}
+  bool enabled() override { return online; }
+  bool needs_restart() override { return false; }
+  int lands_for_hell() override { return 9; }
+  bool land_unlocked(eLand l) override { return true; }
+  void send(const vector<ap_event>& batch) override {
+    #if CAP_THREAD
+    if(latency_ms) std::this_thread::sleep_for(std::chrono::milliseconds(latency_ms));
+    #endif
+    for(auto& e: batch) received.push_back(e);
+    }
+  };
+
+ap_client default_client;
+client *current = &default_client;
+std::unique_ptr<loopback_client> loopback;
+
+/** how often the I/O thread refreshes the cached slot data, in milliseconds */
+EX int refresh_ms = 250;
+
+/** how long the I/O thread collects location checks before sending them, in milliseconds */
+EX int batch_ms = 500;
+
+/** where the queued and sent checks are recorded, followed by the hash of the slot; empty to disable */
+EX string journal_file = "archipelago.journal";
+
+/** the server, slot and seed of the current multiworld, as reported by the client with set_slot;
+ *  slot_key is the one the journal belongs to (owned by the I/O thread while it runs), requested_slot the last one reported */
+string slot_key, requested_slot;
+
+string journal_path() {
+  if(journal_file == "" || slot_key == "") return "";
+  unsigned long long h = 0xCBF29CE484222325ull;
+  for(char c: slot_key) h = (h ^ (unsigned char) c) * 0x100000001B3ull;
+  char buf[20];
+  snprintf(buf, 20, "%016llx", h);
+  return journal_file + "-" + buf;
+  }
+
+/** cached slot data; c_connected is what the client reported on the last refresh */
+shared<bool> c_connected, c_restart;
+/** the client has been enabled in this game, so the checks are still journaled while it is not */
+shared<bool> session;
+shared<int> c_lands_for_hell;
+shared<bool> c_unlocked[landtypes];
+
+/** statistics; written by the I/O thread (except posted, duplicates and stalls) */
+shared<long long> posted, delivered, duplicates, batches, replayed, stalls, refreshes, total_latency_us, max_latency_us;
+shared<int> max_depth;
+
+/** the key of a location: the treasure, or 0 for the goal */
+int location_of(const ap_event& e) { return e.kind == evYendor ? 0 : e.arg; }
+
+/** game thread: the locations already posted */
+std::array<bool, ittypes> checked;
+
+/** I/O thread: the checks not sent yet, and the locations confirmed as sent */
+vector<ap_event> batch;
+long long batch_started;
+std::array<bool, ittypes> confirmed;
+shared<bool> replay_pending;
+FILE *journal;
+
+/** journal records are three bytes: flags (jSent, jGoal), then the treasure as a 16-bit number */
+static constexpr int jSent = 1, jGoal = 2;
+
+void journal_write(const ap_event& e, bool sent) {
+  string fname = journal_path();
+  if(fname == "") return;
+  if(!journal) journal = fopen(fname.c_str(), "ab");
+  if(!journal) return;
+  unsigned char rec[3] = { (unsigned char) ((sent ? jSent : 0) | (e.kind == evYendor ? jGoal : 0)), (unsigned char) (e.arg & 255), (unsigned char) (e.arg >> 8) };
+  fwrite(rec, 3, 1, journal);
+  }
+
+void journal_close() {
+  if(journal) fclose(journal);
+  journal = nullptr;
+  }
+
+/** read the journal into the set of sent locations and the list of checks queued but never sent, and rewrite it compacted */
+void journal_read(std::array<bool, ittypes>& sent, vector<ap_event>& pending) {
+  sent.fill(false); pending.clear();
+  string fname = journal_path();
+  if(fname == "") return;
+  journal_close();
+  FILE *f = fopen(fname.c_str(), "rb");
+  if(!f) return;
+  std::array<bool, ittypes> queued = {};
+  vector<ap_event> order;
+  unsigned char rec[3];
+  while(fread(rec, 3, 1, f) == 1) {
+    ap_event e { (rec[0] & jGoal) ? evYendor : evTreasure, rec[1] + (rec[2] << 8), 0 };
+    int loc = location_of(e);
+    if(loc >= ittypes) continue;
+    if(rec[0] & jSent) sent[loc] = true;
+    else if(!queued[loc]) { queued[loc] = true; order.push_back(e); }
+    }
+  fclose(f);
+  for(auto& e: order) if(!sent[location_of(e)]) pending.push_back(e);
+  f = fopen(fname.c_str(), "wb");
+  if(!f) return;
+  journal = f;
+  for(int i=0; i<ittypes; i++) if(sent[i]) journal_write(i ? ap_event{evTreasure, i, 0} : ap_event{evYendor, 0, 0}, true);
+  for(auto& e: pending) journal_write(e, false);
+  fflush(journal);
+  }
+
+/** I/O thread: a new check arrived from the game */
+void accept(const ap_event& e) {
+  if(confirmed[location_of(e)]) { delivered += 1; return; }
+  for(auto& b: batch) if(location_of(b) == location_of(e)) { delivered += 1; return; }
+  journal_write(e, false);
+  if(batch.empty()) batch_started = now_us();
+  batch.push_back(e);
+  }
+
+/** I/O thread, after (re)connecting: add the checks which the journal knows were never sent */
+void replay() {
+  vector<ap_event> pending;
+  journal_read(confirmed, pending);
+  long long t = now_us();
+  for(auto e: pending) {
+    bool known = false;
+    for(auto& b: batch) if(location_of(b) == location_of(e)) known = true;
+    if(known) continue;
+    e.posted = t;
+    if(batch.empty()) batch_started = t;
+    batch.push_back(e);
+    posted += 1; replayed += 1;
+    }
+  replay_pending = false;
+  }
+
+void send_batch() {
+  if(batch.empty() || !c_connected) return;
+  current->send(batch);
+  long long t = now_us();
+  for(auto& e: batch) {
+    journal_write(e, true);
+    confirmed[location_of(e)] = true;
+    long long lat = t - e.posted;
+    total_latency_us += lat;
+    if(lat > max_latency_us) max_latency_us = lat;
+    }
+  if(journal) fflush(journal);
+  delivered += isize(batch);
+  batches += 1;
+  batch.clear();
+  }
+
+void refresh() {
+  bool on = current->enabled();
+  if(on && !c_connected) replay_pending = true;
+  c_connected = on;
+  refreshes += 1;
+  if(!on) return;
+  session = true;
+  c_restart = current->needs_restart();
+  c_lands_for_hell = current->lands_for_hell();
+  for(int l=0; l<landtypes; l++) c_unlocked[l] = current->land_unlocked(eLand(l));
+  }
+
+/** the game thread starts: which locations were already checked in the earlier sessions */
+void load_checked() {
+  std::array<bool, ittypes> sent = {};
+  vector<ap_event> pending;
+  journal_read(sent, pending);
+  checked = sent;
+  for(auto& e: pending) checked[location_of(e)] = true;
+  replay_pending = true;
+  }
+
+/** I/O thread (or the game thread, if it is not running): the checks from now on belong to the given slot;
+ *  the unsent checks of the old slot stay in its journal */
+void switch_slot(const string& key) {
+  journal_close();
+  batch.clear();
+  slot_key = key;
+  replay();
+  }
+
+#if CAP_THREAD
+std::mutex client_lock;
+
+static constexpr int ring_size = 1024;
+ap_event ring[ring_size];
+/** head is only written by the game thread, tail only by the I/O thread */
+std::atomic<unsigned> head{0}, tail{0};
+std::atomic<bool> quitting{false}, refresh_now{false}, flush_now{false};
+/** should the checks still queued be sent when the I/O thread stops */
+std::atomic<bool> deliver_on_quit{true};
+std::thread io;
+bool started;
+
+/** the keys of the evSlot events in the ring */
+std::mutex slot_lock;
+vector<string> slot_queue;
+
+/** the I/O thread sleeps on wake until there is something to do, or until the next refresh or batch is due */
+std::mutex wake_lock;
+std::condition_variable wake;
+
+void wake_io() {
+  { std::unique_lock<std::mutex> lk(wake_lock); }
+  wake.notify_one();
+  }
+
+bool push(const ap_event& e) {
+  unsigned h = head.load(std::memory_order_relaxed);
+  if(h - tail.load(std::memory_order_acquire) >= ring_size) return false;
+  ring[h % ring_size] = e;
+  head.store(h+1, std::memory_order_release);
+  return true;
+  }
+
+bool pop(ap_event& e) {
+  unsigned t = tail.load(std::memory_order_relaxed);
+  if(t == head.load(std::memory_order_acquire)) return false;
+  e = ring[t % ring_size];
+  tail.store(t+1, std::memory_order_release);
+  return true;
+  }
+
+EX int depth() { return head.load() - tail.load(); }
+
+void io_loop() {
+  long long last_refresh = now_us();
+  while(true) {
+    bool quit = quitting;
+    bool flush = flush_now.exchange(false);
+    ap_event e;
+    bool goal = false;
+    while(pop(e)) {
+      if(e.kind == evSlot) {
+        string key;
+        { std::unique_lock<std::mutex> lk(slot_lock); key = slot_queue.front(); slot_queue.erase(slot_queue.begin()); }
+        switch_slot(key);
+        continue;
+        }
+      accept(e);
+      if(e.kind == evYendor) goal = true;
+      }
+    if(refresh_now.exchange(false) || now_us() - last_refresh >= refresh_ms * 1000LL) {
+      std::unique_lock<std::mutex> lk(client_lock);
+      refresh();
+      last_refresh = now_us();
+      }
+    if(replay_pending && c_connected) replay();
+    if(!batch.empty() && ((quit && deliver_on_quit) || goal || flush || now_us() - batch_started >= batch_ms * 1000LL)) {
+      std::unique_lock<std::mutex> lk(client_lock);
+      send_batch();
+      }
+    if(quit) { journal_close(); return; }
+    long long t = now_us();
+    long long wait_us = refresh_ms * 1000LL - (t - last_refresh);
+    if(!batch.empty()) wait_us = min(wait_us, batch_ms * 1000LL - (t - batch_started));
+    std::unique_lock<std::mutex> lk(wake_lock);
+    wake.wait_for(lk, std::chrono::microseconds(max(wait_us, 0LL)), [] { return quitting || refresh_now || flush_now || depth() > 0; });
+    }
+  }
+
+EX void start() {
+  if(started) return;
+  started = true;
+  load_checked();
+  refresh();
+  quitting = false;
+  io = std::thread(io_loop);
+  }
+
+/** stop the I/O thread; the checks still queued are journaled, and sent if deliver is set */
+void stop_io(bool deliver) {
+  if(!started) return;
+  deliver_on_quit = deliver;
+  quitting = true;
+  wake_io();
+  io.join();
+  started = false;
+  }
+
+void post(eEventKind kind, int arg) {
+  if(!enabled() && !session) return;
+  ap_event e{kind, arg, now_us()};
+  if(checked[location_of(e)]) { duplicates += 1; return; }
+  checked[location_of(e)] = true;
+  posted += 1;
+  while(!push(e)) { stalls += 1; wake_io(); std::this_thread::yield(); }
+  wake_io();
+  int d = depth();
+  if(d > max_depth) max_depth = d;
+  }
+
+/** run f on the game thread with exclusive access to the client */
+EX void with_client(const reaction_t& f) {
+  std::unique_lock<std::mutex> lk(client_lock);
+  f();
+  }
+
+/** send the current batch now, and wait until everything posted so far is delivered (unless offline) */
+EX void flush() {
+  flush_now = true;
+  wake_io();
+  while(started && c_connected && (replay_pending || delivered < posted)) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+#else
+bool started;
+EX int depth() { return 0; }
+EX void start() { if(!started) { started = true; load_checked(); refresh(); } }
+void stop_io(bool deliver) { if(started) { if(deliver) send_batch(); journal_close(); started = false; } }
+void post(eEventKind kind, int arg) {
+  if(!enabled() && !session) return;
+  ap_event e{kind, arg, now_us()};
+  if(checked[location_of(e)]) { duplicates += 1; return; }
+  checked[location_of(e)] = true;
+  posted += 1;
+  accept(e);
+  refresh();
+  if(replay_pending && c_connected) replay();
+  send_batch();
+  }
+EX void with_client(const reaction_t& f) { f(); }
+EX void flush() { }
+#endif
+
+/** deliver everything still queued, and stop the I/O thread */
+EX void stop() { stop_io(true); }
+
+/** called by the client when it connects, with anything which identifies the multiworld slot (server, slot name, seed);
+ *  the checks of another slot are kept in its own journal, and are not sent to this one.
+ *  The I/O thread switches the journal when it gets to this point of the queue, so this does not wait for it,
+ *  and may be called with the client locked. */
+EX void set_slot(const string& key) {
+  if(key == requested_slot) return;
+  requested_slot = key;
+  /* the I/O thread drops the checks already sent or queued in the new slot */
+  checked.fill(false);
+  #if CAP_THREAD
+  if(started) {
+    { std::unique_lock<std::mutex> lk(slot_lock); slot_queue.push_back(key); }
+    while(!push(ap_event{evSlot, 0, 0})) { stalls += 1; wake_io(); std::this_thread::yield(); }
+    wake_io();
+    return;
+    }
+  #endif
+  switch_slot(key);
+  }
+
+/** the next refresh should not wait for refresh_ms */
+void request_refresh() {
+  #if CAP_THREAD
+  refresh_now = true;
+  wake_io();
+  #else
+  if(started) refresh();
+  #endif
+  }
+
+/** the I/O thread (and the journal) are started only once the client reports that Archipelago is enabled;
+ *  until then, the client is asked directly, as this is called in the ordinary games too */
+EX bool enabled() {
+  if(!started) {
+    bool on = false;
+    with_client([&] { on = current->enabled(); });
+    if(!on) return false;
+    start();
+    }
+  return c_connected;
+  }
+
+EX bool needs_restart() { return enabled() && c_restart; }
+EX int lands_for_hell() { enabled(); return c_lands_for_hell; }
+EX bool land_unlocked(eLand l) { enabled(); return c_unlocked[l]; }
+
+EX void post_yendor() { post(evYendor, 0); }
+EX void post_treasure(eItem it) { post(evTreasure, it); }
+
+EX void restart_game() {
+  with_client([] { ap::restartGame(); refresh(); });
+  }
+
+EX void reset_stats() {
+  posted = delivered = duplicates = batches = replayed = stalls = refreshes = total_latency_us = max_latency_us = 0;
+  max_depth = 0;
+  }
+
+/** stop the I/O thread and forget which locations were checked */
+EX void reset_journal() {
+  stop();
+  if(journal_path() != "") remove(journal_path().c_str());
+  checked.fill(false); confirmed.fill(false);
+  batch.clear();
+  c_connected = session = false;
+  }
+
+EX string status_line() {
+  long long d = delivered;
+  string s = XLAT("queue: %1 waiting (max %2), %3 sent in %4 batches",
+    its(depth()), its(max_depth), its(int(d)), its(int(batches)));
+  if(session && !c_connected) s += XLAT(" (offline)");
+  return s + XLAT(", latency %1 ms avg / %2 ms max",
+    fts(d ? total_latency_us / 1000. / d : 0, 3), fts(max_latency_us / 1000., 3));
+  }
+
+EX void show_stats() {
+  cmode = sm::SIDE | sm::MAYDARK;
+  gamescreen();
+  dialog::init(XLAT("Archipelago I/O"));
+  dialog::addSelItem(XLAT("events posted"), its(int(posted)), 0);
+  dialog::addSelItem(XLAT("events delivered"), its(int(delivered)), 0);
+  dialog::addSelItem(XLAT("batches sent"), its(int(batches)), 0);
+  dialog::addSelItem(XLAT("duplicate checks dropped"), its(int(duplicates)), 0);
+  dialog::addSelItem(XLAT("checks replayed from the journal"), its(int(replayed)), 0);
+  dialog::addSelItem(XLAT("connection"), c_connected ? XLAT("online") : XLAT("offline"), 0);
+  dialog::addSelItem(XLAT("queue depth"), its(depth()), 0);
+  dialog::addSelItem(XLAT("maximum queue depth"), its(max_depth), 0);
+  dialog::addSelItem(XLAT("stalls on a full queue"), its(int(stalls)), 0);
+  long long d = delivered;
+  dialog::addSelItem(XLAT("average latency (ms)"), fts(d ? total_latency_us / 1000. / d : 0, 3), 0);
+  dialog::addSelItem(XLAT("maximum latency (ms)"), fts(max_latency_us / 1000., 3), 0);
+  dialog::addSelItem(XLAT("slot data refreshes"), its(int(refreshes)), 0);
+  dialog::addBreak(50);
+  dialog::addItem(XLAT("reset statistics"), 'r');
+  dialog::add_action(reset_stats);
+  dialog::addItem(XLAT("forget the checked locations"), 'j');
+  dialog::add_action(reset_journal);
+  dialog::addBack();
+  dialog::display();
+  }
+
+/** the Archipelago menu, with the queue statistics at the bottom of the screen */
+EX void show_menu() {
+  with_client(ap::showArchipelagoMenu);
+  auto kh = keyhandler;
+  keyhandler = [kh] (int sym, int uni) { with_client([&] { kh(sym, uni); }); };
+  displaystr(vid.xres/2, vid.yres - vid.fsize * 3/2, 0, vid.fsize, status_line(), dialog::dialogcolor, 8);
+  request_refresh();
+  }
+
+/** test the queue against a loopback client with the given latency: `qty` pickups made offline must be
+ *  sent exactly once per treasure, in order, after a restart and a reconnect */
+EX bool loopback_test(int qty, int latency) {
+  dynamicval<string> jf(journal_file, "loopback-test.journal");
+  string old_slot = requested_slot;
+  set_slot("loopback test");
+  reset_journal();
+  loopback = std::make_unique<loopback_client>(latency);
+  current = &*loopback;
+  int k = min(qty, ittypes-1);
+
+  /* connect, then lose the connection */
+  enabled();
+  with_client([] { loopback->online = false; refresh(); });
+  reset_stats();
+  long long t0 = now_us();
+  for(int i=0; i<qty; i++) post_treasure(eItem(1 + i % (ittypes-1)));
+  long long t1 = now_us();
+  stop();
+  bool ok = loopback->received.empty() && posted == k && duplicates == qty - k;
+
+  /* a new session: only the journal remembers the checks */
+  checked.fill(false); confirmed.fill(false); batch.clear();
+  loopback->online = true;
+  reset_stats();
+  long long t2 = now_us();
+  for(int i=0; i<qty; i++) post_treasure(eItem(1 + i % (ittypes-1)));
+  flush();
+  long long t3 = now_us();
+  ok = ok && isize(loopback->received) == k && replayed == k && duplicates == qty;
+  for(int i=0; ok && i<k; i++) ok = loopback->received[i].arg == 1 + i;
+  println(hlog, "loopback: ", qty, " pickups posted in ", (t1-t0)/1000., " ms offline, ", k, " checks replayed and delivered in ", (t3-t2)/1000., " ms, ", ok ? "OK" : "FAILED");
+  println(hlog, status_line());
+
+  reset_journal();
+  current = &default_client;
+  loopback = nullptr;
+  set_slot(old_slot);
+  return ok;
+  }
+
+auto hooks = addHook(hooks_final_cleanup, 100, stop)
+  /* a game started without Archipelago: its checks are not for the slot */
+  + addHook(hooks_initgame, 100, [] { if(!c_connected) session = false; })
+  + addHook(hooks_configfile, 100, [] {
+    param_i(refresh_ms, "archipelago_refresh", 250)
+    ->editable(10, 2000, 50, "Archipelago: slot data refresh (ms)", "", 'f');
+    param_i(batch_ms, "archipelago_batch", 500)
+    ->editable(0, 5000, 100, "Archipelago: batch location checks (ms)", "", 'b');
+    param_str(journal_file, "archipelago_journal");
+    })
+  #if CAP_COMMANDLINE
+  + addHook(hooks_args, 100, [] {
+    using namespace arg;
+    if(0) ;
+    else if(argis("-ap-loopback")) {
+      shift(); int lat = argi();
+      stop();
+      loopback = std::make_unique<loopback_client>(lat);
+      current = &*loopback;
+      }
+    else if(argis("-ap-loopback-test")) {
+      shift(); int qty = argi();
+      shift(); int lat = argi();
+      loopback_test(qty, lat);
+      }
+    else if(argis("-ap-stats")) {
+      PHASEFROM(3);
+      pushScreen(show_stats);
+      }
+    else return 1;
+    return 0;
+    })
+  #endif
+  ;
+
+EX }
+
+}
@@ -475,6 +475,8 @@ struct fontdata {
   bool use_fontconfig;
   #endif
   struct glfont_t* glfont[max_glfont_size+1];
+  /** has init_glfont been run (even if some of the sizes failed to load) */
+  bool glatlas;
   #if CAP_SDLTTF
   TTF_Font* font[max_font_size+1];
   #endif
@@ -497,6 +499,7 @@ EX fontdata* font_by_name(string fname) {
     fd.use_fontconfig = true;
     #endif
     for(int i=0; i<=max_glfont_size; i++) fd.glfont[i] = nullptr;
+    fd.glatlas = false;
     #if CAP_SDLTTF
     for(int i=0; i<=max_font_size; i++) fd.font[i] = nullptr;
     #endif
@@ -542,6 +545,7 @@ void sdltogl(SDL_Surface *txt, glfont_t& f, int ch) {
 #endif
   
   if(otwidth+curx+1 > FONTTEXTURESIZE) curx = 0, cury += theight+1, theight = 0;
+  if(cury + otheight > FONTTEXTURESIZE) return;
   
   theight = max(theight, otheight);
   
@@ -566,24 +570,99 @@ void sdltogl(SDL_Surface *txt, glfont_t& f, int ch) {
   curx += otwidth+1;
   }
   
-EX void init_glfont(int size) {
-  if(cfont->glfont[size]) return;
-  DEBBI(DF_GRAPH, ("init GL font: ", size));
-  
-#if !CAP_TABFONT
-  loadfont(size);
-  if(!cfont->font[size]) return;
+/** \brief the sizes in the glyph atlas; other sizes are drawn scaled down from the next larger one */
+#if CAP_FIXEDSIZE
+const vector<int> glfont_tiers = { CAP_FIXEDSIZE };
+#else
+const vector<int> glfont_tiers = { 8, 10, 12, 14, 16, 18, 20, 24, 28, 32, 40, 48, 56, 64, max_glfont_size };
 #endif
-  
-  cfont->glfont[size] = new glfont_t;
-  
-  glfont_t& f(*(cfont->glfont[size]));
-  
-  f.chars.resize(CHARS);
 
-//f.list_base = glGenLists(128);
-  glGenTextures(1, &f.texture );
+/** \brief the size in the glyph atlas used to draw text of the given size */
+EX int glfont_tier(int size) {
+  for(int t: glfont_tiers) if(t >= size) return t;
+  return glfont_tiers.back();
+  }
+
+#define GLYPH_CACHE (!CAP_TABFONT && !CAP_CREATEFONT)
+
+#if GLYPH_CACHE
+bool glyph_cache = true;
 
+#if CAP_COMMANDLINE
+auto ah_glyph_cache = addHook(hooks_args, 100, [] {
+  using namespace arg;
+  if(0) ;
+  else if(argis("-no-glyph-cache")) glyph_cache = false;
+  else return 1;
+  return 0;
+  });
+#endif
+
+/** \brief everything the atlas depends on: when any of this changes, the cached atlas is not used */
+string glyph_cache_key() {
+  shstream ss;
+  hwrite(ss, 1, FONTTEXTURESIZE, CHARS, glfont_tiers);
+  for(int i=0; i<NUMEXTRA; i++) hwrite(ss, string(natchars[i]));
+  string fname = find_file(cfont->filename);
+  hwrite(ss, fname);
+  long long fsize = 0, mtime = 0;
+  #if CAP_FILES
+  struct stat attr;
+  if(!stat(fname.c_str(), &attr)) fsize = attr.st_size, mtime = attr.st_mtime;
+  #endif
+  hwrite(ss, fsize, mtime);
+  return ss.s;
+  }
+
+string glyph_cache_file(const string& key) {
+  return string(conffile) + ".glyphs-" + itsh((unsigned long long) std::hash<string>()(key));
+  }
+
+/** \brief read the atlas into fontpixels and the glyph sizes into the glfont_t's of cfont */
+bool load_glyph_cache(const string& key) {
+  fhstream f(glyph_cache_file(key), "rb");
+  if(!f.f) return false;
+  try {
+    if(f.get<string>() != key) return false;
+    int rows = f.get<int>();
+    if(rows < 0 || rows > FONTTEXTURESIZE) return false;
+    vector<vector<charinfo_t>> chars(isize(glfont_tiers), vector<charinfo_t>(CHARS));
+    for(auto& v: chars) for(auto& c: v) hread_raw(f, c);
+    vector<unsigned char> alpha(rows * FONTTEXTURESIZE);
+    if(rows) f.read_chars((char*) &alpha[0], isize(alpha));
+    for(int y=0; y<rows; y++) for(int x=0; x<FONTTEXTURESIZE; x++)
+      fontpixels[y][x] = (alpha[y*FONTTEXTURESIZE+x] * 0x100) | 0xFF;
+    for(int i=0; i<isize(glfont_tiers); i++) {
+      auto& gf = cfont->glfont[glfont_tiers[i]];
+      gf = new glfont_t;
+      gf->chars = chars[i];
+      }
+    cury = rows; curx = 0; theight = 0;
+    return true;
+    }
+  catch(hstream_exception&) { return false; }
+  }
+
+void save_glyph_cache(const string& key, int rows) {
+  /* a size which failed to load would be missing from the cache */
+  for(int t: glfont_tiers) if(!cfont->glfont[t]) return;
+  string fname = glyph_cache_file(key);
+  try {
+    fhstream f(fname, "wb");
+    if(!f.f) return;
+    hwrite(f, key, rows);
+    for(int t: glfont_tiers) for(auto& c: cfont->glfont[t]->chars) hwrite_raw(f, c);
+    vector<unsigned char> alpha(rows * FONTTEXTURESIZE);
+    for(int y=0; y<rows; y++) for(int x=0; x<FONTTEXTURESIZE; x++)
+      alpha[y*FONTTEXTURESIZE+x] = fontpixels[y][x] >> 8;
+    if(rows) f.write_chars((char*) &alpha[0], isize(alpha));
+    }
+  catch(hstream_exception&) { remove(fname.c_str()); }
+  }
+#endif
+
+/** \brief rasterize the glyphs of cfont in all the sizes of glfont_tiers into fontpixels */
+void render_glyph_atlas() {
 #if !CAP_TABFONT
   char str[2]; str[1] = 0;
   
@@ -591,64 +670,105 @@ EX void init_glfont(int size) {
   white.r = white.g = white.b = 255;
 #endif
 
-  for(int y=0; y<FONTTEXTURESIZE; y++)
-  for(int x=0; x<FONTTEXTURESIZE; x++)
-    fontpixels[y][x] = 0;
-
 #if CAP_TABFONT
   resetTabFont();
 #endif
   
-//  glListBase(0);
-
   curx = 0, cury = 0, theight = 0;
-  
-  for(int ch=1;ch<CHARS;ch++) {
-  
-    if(ch<32) continue;
+
+  for(int size: glfont_tiers) {
+#if !CAP_TABFONT
+    loadfont(size);
+    if(!cfont->font[size]) continue;
+#endif
+    cfont->glfont[size] = new glfont_t;
+    glfont_t& f(*(cfont->glfont[size]));
+    f.chars.resize(CHARS);
+
+    /* every size starts a new row */
+    if(curx) curx = 0, cury += theight+1, theight = 0;
+
+    for(int ch=1;ch<CHARS;ch++) {
+    
+      if(ch<32) continue;
 
 #if CAP_TABFONT
-    sdltogl(NULL, f, ch);
+      sdltogl(NULL, f, ch);
 
 #else
-    SDL_Surface *txt;
-    int siz = size;
-    fix_font_size(siz);
-    if(ch < 128) {
-      str[0] = ch;
-      txt = TTF_RenderUTF8_Blended(cfont->font[siz], str, white);
-      }
-    else {
-      txt = TTF_RenderUTF8_Blended(cfont->font[siz], natchars[ch-128], white);
-      }
-    if(txt == NULL) continue;
+      SDL_Surface *txt;
+      if(ch < 128) {
+        str[0] = ch;
+        txt = TTF_RenderUTF8_Blended(cfont->font[size], str, white);
+        }
+      else {
+        txt = TTF_RenderUTF8_Blended(cfont->font[size], natchars[ch-128], white);
+        }
+      if(txt == NULL) continue;
 #if CAP_CREATEFONT
-    generateFont(ch, txt);
+      if(size == CAP_FIXEDSIZE) generateFont(ch, txt);
 #endif
-    sdltogl(txt, f, ch);
-    SDL_DestroySurface(txt);
+      sdltogl(txt, f, ch);
+      SDL_DestroySurface(txt);
 #endif
+      }
     }
 
-  glBindTexture( GL_TEXTURE_2D, f.texture);
+  cury += theight; theight = 0;
+ 
+#if CAP_CREATEFONT
+  printf("#define NUMEXTRA %d\n", NUMEXTRA);
+#define DEMACRO(x) #x
+  printf("#define NATCHARS " DEMACRO(NATCHARS) "\n");
+#endif
+  }
+
+/** \brief create the glyph atlas of cfont, shared by all the sizes in glfont_tiers
+ *
+ *  Sizes which are not in glfont_tiers do not get a glfont_t; use glfont_tier to choose the size to draw with.
+ *  The atlas is stored on disk (next to the config file), so usually nothing needs to be rasterized.
+ */
+EX void init_glfont(int size) {
+  if(cfont->glfont[size] || cfont->glatlas) return;
+  cfont->glatlas = true;
+  DEBBI(DF_GRAPH, ("init GL font atlas"));
+  auto t0 = std::chrono::steady_clock::now();
+
+  for(int y=0; y<FONTTEXTURESIZE; y++)
+  for(int x=0; x<FONTTEXTURESIZE; x++)
+    fontpixels[y][x] = 0;
+
+  bool from_cache = false;
+#if GLYPH_CACHE
+  string key = glyph_cache_key();
+  if(glyph_cache) from_cache = load_glyph_cache(key);
+#endif
+  if(!from_cache) render_glyph_atlas();
+  int rows = cury;
+#if GLYPH_CACHE
+  if(glyph_cache && !from_cache) save_glyph_cache(key, rows);
+#endif
+
+  GLuint texture;
+  glGenTextures(1, &texture);
+  glBindTexture( GL_TEXTURE_2D, texture);
   glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
   glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
   
-  theight = next_p2(cury + theight);
+  int height = next_p2(max(rows, 1));
   
-  glTexImage2D( GL_TEXTURE_2D, 0, GL_LUMINANCE_ALPHA, FONTTEXTURESIZE, theight, 0,
+  glTexImage2D( GL_TEXTURE_2D, 0, GL_LUMINANCE_ALPHA, FONTTEXTURESIZE, height, 0,
     GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE, 
     fontpixels);
 
-  for(int ch=0; ch<CHARS; ch++) f.chars[ch].ty0 /= theight, f.chars[ch].ty1 /= theight;
- 
-#if CAP_CREATEFONT
-  printf("#define NUMEXTRA %d\n", NUMEXTRA);
-#define DEMACRO(x) #x
-  printf("#define NATCHARS " DEMACRO(NATCHARS) "\n");
-#endif
+  for(int t: glfont_tiers) if(cfont->glfont[t]) {
+    auto& f = *cfont->glfont[t];
+    f.texture = texture;
+    for(auto& c: f.chars) c.ty0 /= height, c.ty1 /= height;
+    }
 
-//printf("init size=%d ok\n", size);
+  if(debugflags & DF_GRAPH)
+    println(hlog, "glyph atlas ", from_cache ? "loaded" : "rendered", " in ", int(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count()), " ms");
   GLERR("initfont");
   }
 
@@ -660,6 +780,7 @@ int gl_width(int size, const char *s) {
   gsiz = CAP_FIXEDSIZE;
 #endif
 
+  gsiz = glfont_tier(gsiz);
   init_glfont(gsiz);
   if(!cfont->glfont[gsiz]) return 0;
 
@@ -693,6 +814,7 @@ bool gl_print(int x, int y, int shift, int size, const char *s, color_t color, i
   gsiz = CAP_FIXEDSIZE;
 #endif
   
+  gsiz = glfont_tier(gsiz);
   init_glfont(gsiz);
   if(!cfont->glfont[gsiz]) return false;
 
@@ -758,10 +880,12 @@ EX void resetGL() {
   DEBBI(DF_INIT | DF_GRAPH, ("reset GL"))
   callhooks(hooks_resetGL);
 #if CAP_GLFONT
-  for(auto& cf: fontdatas)
-  for(int i=0; i<=max_glfont_size; i++) if(cf.second.glfont[i]) {
-    delete cf.second.glfont[i];
-    cf.second.glfont[i] = NULL;
+  for(auto& cf: fontdatas) {
+    for(int i=0; i<=max_glfont_size; i++) if(cf.second.glfont[i]) {
+      delete cf.second.glfont[i];
+      cf.second.glfont[i] = NULL;
+      }
+    cf.second.glatlas = false;
     }
 #endif
 #if MAXMDIM >= 4
@@ -860,6 +984,102 @@ EX bool displaystr(int x, int y, int shift, int size, char const *s, color_t col
   }
 
 #endif
+
+#if CAP_SDLTTF && !CAP_XGD
+/** \brief the text surfaces rendered by displaystr without OpenGL, reused while the same strings are drawn */
+EX namespace text_cache {
+
+/** the memory used by the cached surfaces, in megabytes */
+EX int limit = 16;
+
+EX int hits, misses, evictions;
+
+/** print the statistics on exit */
+EX bool report = false;
+
+struct entry {
+  SDL_Surface *txt;
+  int bytes;
+  /** the value of `uses` when last drawn */
+  long long last_used;
+  };
+
+std::unordered_map<string, entry> cache;
+long long bytes, uses;
+
+string make_key(fontdata *f, int size, SDL_Color col, bool blended, const char *str) {
+  string key;
+  key.append((const char*) &f, sizeof(f));
+  key += char(size & 255); key += char(size >> 8);
+  key += char(col.r); key += char(col.g); key += char(col.b);
+  key += char(blended);
+  key += str;
+  return key;
+  }
+
+/** \brief free the least recently used surfaces, until at most `target` bytes are used */
+void evict(long long target) {
+  vector<pair<long long, string>> by_use;
+  for(auto& p: cache) by_use.emplace_back(p.second.last_used, p.first);
+  sort(by_use.begin(), by_use.end());
+  for(auto& u: by_use) {
+    if(bytes <= target) break;
+    auto& e = cache[u.second];
+    bytes -= e.bytes;
+    SDL_DestroySurface(e.txt);
+    cache.erase(u.second);
+    evictions++;
+    }
+  }
+
+EX void clear() {
+  evict(0);
+  }
+
+/** \brief the rendered text; owned by the cache, valid until the next call */
+SDL_Surface *render(int size, SDL_Color col, const char *str) {
+  bool blended = vid.antialias & AA_FONT;
+  string key = make_key(cfont, size, col, blended, str);
+  auto it = cache.find(key);
+  if(it != cache.end()) {
+    hits++;
+    it->second.last_used = ++uses;
+    return it->second.txt;
+    }
+  misses++;
+  SDL_Surface *txt = (blended ? TTF_RenderUTF8_Blended : TTF_RenderUTF8_Solid)(cfont->font[size], str, col);
+  if(!txt) return nullptr;
+  /* evict a quarter at once, so that a full cache does not sort on every miss */
+  long long budget = limit * 1048576ll;
+  if(bytes + txt->pitch * txt->h > budget) evict(budget * 3 / 4);
+  cache[key] = entry{txt, txt->pitch * txt->h, ++uses};
+  bytes += txt->pitch * txt->h;
+  return txt;
+  }
+
+EX void show_stats() {
+  println(hlog, "text cache: ", hits, " hits, ", misses, " misses, ", evictions, " evictions, ", isize(cache), " surfaces using ", int(bytes / 1024), " KB");
+  }
+
+auto hooks = addHook(hooks_clear_cache, 0, clear)
+  + addHook(hooks_final_cleanup, 0, [] { if(report) show_stats(); clear(); })
+  + addHook(hooks_configfile, 100, [] {
+    param_i(limit, "text_cache_limit", 16);
+    })
+#if CAP_COMMANDLINE
+  + addHook(hooks_args, 100, [] {
+    using namespace arg;
+    if(0) ;
+    else if(argis("-text-cache-stats")) report = true;
+    else return 1;
+    return 0;
+    })
+#endif
+  ;
+
+EX }
+#endif
+
 #if !CAP_XGD
 EX bool displaystr(int x, int y, int shift, int size, const char *str, color_t color, int align) {
 
@@ -889,7 +1109,7 @@ EX bool displaystr(int x, int y, int shift, int size, const char *str, color_t c
   fix_font_size(size);
   loadfont(size);
 
-  SDL_Surface *txt = ((vid.antialias & AA_FONT)?TTF_RenderUTF8_Blended:TTF_RenderUTF8_Solid)(cfont->font[size], str, col);
+  SDL_Surface *txt = text_cache::render(size, col, str);
   
   if(txt == NULL) return false;
 
@@ -925,7 +1145,6 @@ EX bool displaystr(int x, int y, int shift, int size, const char *str, color_t c
   else {
     SDL_BlitSurface(txt, NULL, s,&rect); 
     }
-  SDL_DestroySurface(txt);
   
   return clicked;
 #endif
@@ -1557,6 +1776,9 @@ fontdata::~fontdata() {
   }
 
 EX void close_font() {
+#if CAP_SDLTTF && !CAP_XGD
+  text_cache::clear();
+#endif
   fontdatas.clear();
 #if CAP_SDLTTF
   TTF_Quit();
@@ -1690,6 +1912,9 @@ EX void initialize_all() {
 
 EX void quit_all() {
   DEBBI(DF_INIT, ("clear graph"));
+#if CAP_SDLAUDIO
+  stop_audio_loader();
+#endif
 #if CAP_SDLJOY
   closeJoysticks();
 #endif
@@ -239,7 +239,11 @@ EX int dirdiff(int dd, int t) {
 
 EX int cellcount = 0;
 
+/** getCdata values (0..3) and getBits (4) of the cells, for the geometries where cdata_cacheable() */
+std::unordered_map<cell*, array<int, 5>> cdata_cache;
+
 EX void destroy_cell(cell *c) {
+  if(!cdata_cache.empty()) cdata_cache.erase(c);
   tailored_delete(c);
   cellcount--;
   }
@@ -1268,7 +1272,71 @@ EX cdata *arcmCdata(cell *c) {
   }
 #endif
 
+EX bool cdata_cacheable() {
+  if(fake::in() || embedded_plane || experimental || mhybrid || INVERSE) return false;
+  if(euc::in()) return true;
+  if(arcm::in()) return euclid;
+  return geometry_supports_cdata();
+  }
+
+/** compute all the values at once; gives the same results as the uncached branches of getCdata and getBits */
+array<int, 5> compute_cdata(cell *c) {
+  array<int, 5> res;
+  cdata *d = nullptr;
+  if(euc::in()) d = getEuclidCdata(euc2_coordinates(c));
+  #if CAP_ARCM
+  else if(arcm::in()) d = getEuclidCdata(pseudocoords(c));
+  #endif
+  if(d) {
+    for(int j=0; j<4; j++) res[j] = d->val[j];
+    res[4] = d->bits;
+    return res;
+    }
+  bool need_masters = !ctof(c) || c != c->master->c7;
+  array<heptagon*, 3> ar;
+  if(need_masters) ar = gp::get_masters(c);
+  if(ctof(c)) {
+    auto h = getHeptagonCdata(c->master);
+    for(int j=0; j<4; j++) res[j] = h->val[j] * 3;
+    }
+  else {
+    for(int j=0; j<4; j++) res[j] = 0;
+    for(int k=0; k<3; k++) {
+      auto h = getHeptagonCdata(ar[k]);
+      for(int j=0; j<4; j++) res[j] += h->val[j];
+      }
+    }
+  if(c == c->master->c7) res[4] = getHeptagonCdata(c->master)->bits;
+  else {
+    int b0 = getHeptagonCdata(ar[0])->bits;
+    int b1 = getHeptagonCdata(ar[1])->bits;
+    int b2 = getHeptagonCdata(ar[2])->bits;
+    res[4] = (b0 & b1) | (b1 & b2) | (b2 & b0);
+    }
+  return res;
+  }
+
+const array<int, 5>& cached_cdata(cell *c) {
+  auto it = cdata_cache.find(c);
+  if(it != cdata_cache.end()) return it->second;
+  return cdata_cache[c] = compute_cdata(c);
+  }
+
+/** resolve the cdata of all the given cells in one pass, so that the later calls to getCdata and getBits are lookups */
+EX void cache_cdata(const vector<cell*>& cells) {
+  if(!cdata_cacheable()) return;
+  cdata_cache.reserve(cdata_cache.size() + cells.size());
+  for(cell *c: cells) if(!cdata_cache.count(c)) cdata_cache[c] = compute_cdata(c);
+  }
+
+/** getCdata(c, 0..3) and getBits(c) at once */
+EX array<int, 5> getCdataAll(cell *c) {
+  if(cdata_cacheable()) return cached_cdata(c);
+  return {getCdata(c, 0), getCdata(c, 1), getCdata(c, 2), getCdata(c, 3), getBits(c)};
+  }
+
 EX int getCdata(cell *c, int j) {
+  if(cdata_cacheable()) return cached_cdata(c)[j];
   if(fake::in()) return FPIU(getCdata(c, j));
   if(embedded_plane) return IPF(getCdata(c, j));
   if(experimental) return 0;
@@ -1296,6 +1364,7 @@ EX int getCdata(cell *c, int j) {
   }
 
 EX int getBits(cell *c) {
+  if(cdata_cacheable()) return cached_cdata(c)[4];
   if(fake::in()) return FPIU(getBits(c));
   if(embedded_plane) return IPF(getBits(c));
   if(experimental) return 0;
@@ -1569,6 +1638,7 @@ EX void clearCellMemory() {
   keep_distances_from.clear(); perma_distances = 0;
   pd_from = NULL;
   gp::gp_adj.clear();
+  cdata_cache.clear();
   }
 
 auto cellhooks = addHook(hooks_clearmemory, 500, clearCellMemory);
@@ -170,6 +170,9 @@ int arg::readCommon() {
 
   if(argis("-s")) { PHASE(2); shift(); scorefile = args(); savefile_selection = false; }
   else if(argis("-no-s")) { PHASE(2); scorefile = ""; savefile_selection = false; }
+#if CAP_SAVE
+  else if(argis("-no-score-index")) { PHASE(2); use_score_index = false; }
+#endif
   else if(argis("-rsrc")) { PHASE(1); shift(); rsrcdir = args(); }
   else if(argis("-nogui")) { PHASE(1); noGUI = true; }
 #ifndef EMSCRIPTEN
@@ -183,6 +186,10 @@ int arg::readCommon() {
 
   else if(argis("-test")) 
     callhooks(hooks_tests);
+  else if(argis("-formula-bench")) {
+    shift(); string s = args();
+    shift(); formula_benchmark(s, argi());
+    }
   else if(argis("-offline")) {
     PHASE(1);
     offlineMode = true;
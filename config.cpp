@@ -1192,6 +1192,7 @@ EX void initConfig() {
   #endif
   #if CAP_SDLAUDIO
   param_b(music_out_of_focus, "music out of focus", false);
+  param_i(sound_cache_limit, "sound_cache_limit", 64);
   #endif
   #if CAP_AUDIO
   param_i(effvolume, "sound effect volume")
@@ -1462,6 +1463,10 @@ EX void initConfig() {
   ->set_extra(draw_crosshair);
   
   param_b(mapeditor::drawplayer, "drawplayer");
+  #if CAP_EDIT
+  param_i(mapeditor::undo_memory_limit, "mapeditor_undo_limit")
+  ->editable(1024, 1<<20, 1024, "map editor undo memory (KB)", "When the undo history of the map editor needs more memory than this, the oldest changes are forgotten.", 'U');
+  #endif
 
   param_color(backcolor, "color:background", false);
   param_color(forecolor, "color:foreground", false);
@@ -1545,6 +1550,7 @@ EX void initConfig() {
   param_i(irr::place_attempts, "irregular-place", 10);
   param_i(irr::rearrange_max_attempts, "irregular-rearrange-max", 50);
   param_i(irr::rearrange_less, "irregular-rearrangeless", 10);
+  param_i(irr::threads, "irregular-threads", 0);
   #endif
   
   param_i(vid.linequality, "line quality", 0);
@@ -2144,6 +2150,14 @@ EX void edit_sightrange() {
     dialog::addSelItem(XLAT("game range bonus"), its(gamerange_bonus), 's');
     dialog::add_action([] () { gamerange_bonus = sightrange_bonus; doOvergenerate(); });
     }
+  if(wdim == 2) {
+    add_edit(speculative::on);
+    if(speculative::on) {
+      add_edit(speculative::ahead);
+      add_edit(speculative::budget_us);
+      dialog::addInfo(speculative::stats());
+      }
+    }
   if(wdim == 3 && !vid.use_smart_range) {
     add_edit(vid.sloppy_3d);
     }
@@ -2342,6 +2356,9 @@ EX void showGraphConfig() {
       if(!vid.usingGL)
         vid.want_antialias ^= AA_NOGL | AA_FONT;
       });
+    #if CAP_SDL
+    add_edit(swr::on);
+    #endif
     }
   else {
     dialog::addSelItem(XLAT("anti-aliasing"), 
@@ -3533,6 +3550,9 @@ EX int config3 = addHook(hooks_configfile, 100, [] {
   param_b(vid.gp_autoscale_heights, "3D Goldberg autoscaling", true);
   auto scf = param_str(scorefile, "savefile");
   scf->be_non_editable(); scf->reaction = [] { if(save_loaded) exit(1); };
+  #if CAP_SAVE
+  param_b(use_score_index, "score_index", true);
+  #endif
   param_b(savefile_selection, "savefile_selection")
   -> editable("select the score/save file on startup", 's')
   -> set_reaction([] {
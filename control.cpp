@@ -1076,6 +1076,11 @@ EX void mainloopiter() {
   if(((SDL_GetMouseState(NULL, NULL) & SDL_BUTTON_MMASK)) && !mouseout2())
     currently_scrolling = true;
 
+  if(timetowait > 0 && (cmode & sm::NORMAL)) {
+    speculative::idle(timetowait);
+    timetowait = lastframe + 1000 / cframelimit - SDL_GetTicks();
+    }
+
   #if SDLVER >= 2
   if(timetowait > 0) {
     if(SDL_WaitEventTimeout(&ev, timetowait)) handle_event(ev);
@@ -1399,8 +1404,8 @@ EX void handle_event(SDL_Event& ev) {
       }
       
     handlekey(sym, uni);
-    if (ap::needsRestart()) {
-      ap::restartGame();
+    if (apq::needs_restart()) {
+      apq::restart_game();
     }
   }
   
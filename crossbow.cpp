@@ -59,7 +59,7 @@ static constexpr flagtype bpCOPIED = 4;
 
 EX vector<bowpoint> bowpath;
 
-EX map<cell*, vector<bowpoint>> bowpath_map;
+EX std::unordered_map<cell*, vector<bowpoint>> bowpath_map;
 
 EX map<int, cell*> target_at;
 
@@ -117,23 +117,71 @@ EX int bolt_score(cellwalker cw2) {
   return ntotal;
   }
 
+/** \brief the position of every cell in dcal, rebuilt when dcal changes */
+std::unordered_map<cell*, int> dcal_index;
+int dcal_index_bfs = -1, dcal_index_size = -1;
+
+void update_dcal_index() {
+  if(dcal_index_bfs == bfs_count && dcal_index_size == isize(dcal)) return;
+  dcal_index.clear();
+  for(int i=0; i<isize(dcal); i++) dcal_index[dcal[i]] = i;
+  dcal_index_bfs = bfs_count; dcal_index_size = isize(dcal);
+  }
+
+/** \brief the last result of create_dirseq, with everything it depends on */
+struct dirseq_cache {
+  bool valid;
+  int bfs, turn, map_version, style, orbs;
+  cellwalker cw;
+  map<int, cell*> targets;
+  vector<int> dirseq;
+  int score;
+  };
+
+dirseq_cache last_dirseq;
+
+int dirseq_orbs() {
+  return (items[itOrbAether] ? 1 : 0) | ((items[itOrbSpeed]&1) ? 2 : 0) | (items[itOrbSlaying] ? 4 : 0) | (items[itCurseWeakness] ? 8 : 0);
+  }
+
+bool dirseq_cached() {
+  auto& l = last_dirseq;
+  return l.valid && !changes.on && l.bfs == bfs_count && l.turn == turncount && l.map_version == mapeditor::map_version
+    && l.style == style && l.orbs == dirseq_orbs() && l.cw == cwt && l.targets == target_at;
+  }
+
 EX vector<int> create_dirseq() {
-  map<cell*, bowscore> scores;
-  scores[cwt.at].total = 0;
+  if(dirseq_cached()) { best_score_res = last_dirseq.score; return last_dirseq.dirseq; }
+
+  /* scores are indexed by the position in dcal; the last slot is for cwt.at if it is not in dcal */
+  update_dcal_index();
+  int N = isize(dcal);
+  auto index_of = [&] (cell *c) { auto it = dcal_index.find(c); return it != dcal_index.end() ? it->second : c == cwt.at ? N : -1; };
+  vector<bowscore> scores(N+1);
+  for(auto& s: scores) s.total = BOLT_INVALID;
+  scores[index_of(cwt.at)].total = 0;
+
+  vector<cell*> target_by_dist;
+  for(auto& t: target_at) if(t.second && t.first >= 0) {
+    if(t.first >= isize(target_by_dist)) target_by_dist.resize(t.first+1, nullptr);
+    target_by_dist[t.first] = t.second;
+    }
 
   int best_score = BOLT_INVALID; cell* best_score_at = cwt.at;
 
-  for(cell *c: dcal) {
-    cell *c1 = target_at[c->cpdist];
+  for(int ci=0; ci<N; ci++) {
+    cell *c = dcal[ci];
+    cell *c1 = c->cpdist < isize(target_by_dist) ? target_by_dist[c->cpdist] : nullptr;
     if(c1 && c != c1) continue;
     if(c == c1) { best_score = BOLT_INVALID; }
     bowscore best;
     best.total = BOLT_INVALID;
-    forCellIdEx(c1, i, c) if(c1->cpdist < c->cpdist && scores.count(c1)) {
-      auto& last = scores[c1];
+    forCellIdEx(c1, i, c) if(c1->cpdist < c->cpdist) {
+      int id1 = index_of(c1);
+      if(id1 < 0 || scores[id1].total == BOLT_INVALID) continue;
+      auto& last = scores[id1];
       auto ocw2 = cellwalker(c, i);
       int bonus = bolt_score(ocw2);
-      println(hlog, "at ", ocw2, " bonus is ", bonus);
       if(bonus == BOLT_INVALID) continue;
       int ntotal = last.total + bonus;
 
@@ -157,20 +205,27 @@ EX vector<int> create_dirseq() {
       best.total = max(best.total, ntotal);
       }
     if(best.total > best_score) { best_score = best.total; best_score_at = c; }
-    if(best.total > BOLT_INVALID) scores[c] = best;
+    if(best.total > BOLT_INVALID) scores[ci] = best;
     }
 
-  if(best_score == BOLT_INVALID) return {};
-
-  vector<int> dirseq = { NODIR };
-  while(best_score_at != cwt.at) { 
-    auto& at = scores[best_score_at];
-    dirseq.push_back(at.turns);
-    best_score_at = at.last.cpeek();
+  vector<int> dirseq;
+  if(best_score != BOLT_INVALID) {
+    dirseq.push_back(NODIR);
+    while(best_score_at != cwt.at) { 
+      auto& at = scores[index_of(best_score_at)];
+      dirseq.push_back(at.turns);
+      best_score_at = at.last.cpeek();
+      }
+    reverse(dirseq.begin(), dirseq.end());
+    best_score_res = best_score;
     }
-  reverse(dirseq.begin(), dirseq.end());
 
-  best_score_res = best_score;
+  if(!changes.on) {
+    auto& l = last_dirseq;
+    l.valid = true; l.bfs = bfs_count; l.turn = turncount; l.map_version = mapeditor::map_version;
+    l.style = style; l.orbs = dirseq_orbs(); l.cw = cwt; l.targets = target_at;
+    l.dirseq = dirseq; l.score = best_score_res;
+    }
   return dirseq;
   }
 
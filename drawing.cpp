@@ -151,7 +151,7 @@ struct dqi_circle : drawqueueitem {
 struct dqi_action : drawqueueitem {
   reaction_t action;
   explicit dqi_action(const reaction_t& a) : action(a) {}
-  void draw() override { action(); }
+  void draw() override;
   color_t outline_group() override { return 2; }
   };
 #endif
@@ -2132,6 +2132,14 @@ void dqi_poly::draw() {
       }
   #endif
   
+  #if CAP_SDLGFX && !CAP_XGD
+    if(swr::active() && !tinf) {
+      swr::draw_poly(glcoords, poly_flags, color, outline, (vid.xres >= 2000 || fatborder) ? 2 : 1);
+      continue;
+      }
+    swr::flush();
+  #endif
+
     coords_to_poly();
   
   #if CAP_XGD
@@ -2251,6 +2259,7 @@ void dqi_line::draw() {
 
 void dqi_string::draw() {
   dynamicval<fontdata*> df(cfont, font);
+  swr::flush();
   #if CAP_SVG
   if(svg::in) {
     svg::text(x, y, size, str, frame, color, align);
@@ -2265,7 +2274,13 @@ void dqi_string::draw() {
   #endif
   }
 
+void dqi_action::draw() {
+  swr::flush();
+  action();
+  }
+
 void dqi_circle::draw() {
+  swr::flush();
   #if CAP_SVG
   if(svg::in) {
     svg::circle(x, y, size, color, fillcolor, linewidth);
@@ -2301,7 +2316,9 @@ EX void quickqueue() {
   spherespecial = 0; 
   reset_projection(); current_display->set_all(0, 0);
   int siz = isize(ptds);
+  dynamicval<bool> db(swr::batching, true);
   for(int i=0; i<siz; i++) ptds[i]->draw();
+  swr::flush();
   ptds.clear();
   clear_curvedata();
   }
@@ -2345,6 +2362,7 @@ void dqi_line::draw_back() {
   }
 
 EX void sort_drawqueue() {
+  PROFILE("sort_drawqueue");
   DEBBI(DF_GRAPH, ("sort_drawqueue"));
   
   for(int a=0; a<PMAX; a++) qp[a] = 0;
@@ -2581,6 +2599,7 @@ EX void draw_main() {
   }
 
 EX void drawqueue() {
+  PROFILE("drawqueue");
 
   DEBBI(DF_GRAPH, ("drawqueue"));
   
@@ -2698,7 +2717,9 @@ EX void drawqueue() {
   else 
 #endif
   {
+    dynamicval<bool> db(swr::batching, true);
     draw_main();
+    swr::flush();
     }    
 
 #if CAP_SDL
@@ -2897,7 +2918,9 @@ EX void write_in_space(const shiftmatrix& V, int fsize, double size, const strin
   if(!cfont->finf) cfont->finf = new basic_textureinfo;
   auto& finf = *cfont->finf;
 
+  fsize = glfont_tier(fsize);
   init_glfont(fsize);
+  if(!cfont->glfont[fsize]) return;
   glfont_t& f(*(cfont->glfont[fsize]));
   finf.texture_id = f.texture;
   
@@ -301,8 +301,13 @@ pathdata::pathdata(eMonster m, bool include_allies IS(true)) {
  **/
 EX vector<int> bfs_reachedfrom;
 
+/** \brief incremented whenever dcal is recomputed */
+EX int bfs_count;
+
 /** calculate cpdist, 'have' flags, and do general fixings */
 EX void bfs() {
+  PROFILE("bfs");
+  bfs_count++;
 
   yendor::onpath();
   
@@ -830,6 +835,7 @@ EX void advance_tides() {
   }
 
 EX void monstersTurn() {
+  PROFILE("monstersTurn");
   reset_spill();
   checkSwitch();
   mirror::breakAll();
@@ -908,6 +914,8 @@ EX void monstersTurn() {
   for(cell *pc: player_positions())
     history::movehistory.push_back(pc);
 #endif
+
+  speculative::plan();
   }
 
 /** check if whirlline is looped, if yes, remove the repeat; may not detect loops immediately */
@@ -22,13 +22,23 @@ void canonicize(vector<int>& t) {
   }
 
 #if HDR
+struct typecode_hash {
+  size_t operator() (const vector<int>& v) const {
+    size_t res = v.size();
+    for(int x: v) res ^= size_t(x) + 0x9e3779b9 + (res << 6) + (res >> 2);
+    return res;
+    }
+  };
+
 struct expansion_analyzer {
   int sibling_limit;
   vector<int> gettype(cell *c);
   int N;
   vector<cell*> samples;  
-  map<vector<int>, int> codeid;  
+  std::unordered_map<vector<int>, int, typecode_hash> codeid;  
   vector<vector<int> > children;  
+  /** children[i] grouped as (type, multiplicity); rebuilt lazily whenever cleared */
+  vector<vector<pair<int, int>>> children_mult;
   int rootid, diskid;
   int coefficients_known;
   #if CAP_GMP
@@ -46,6 +56,13 @@ struct expansion_analyzer {
   bignum& get_descendants(int level);
   bignum& get_descendants(int level, int type);
   void find_coefficients();
+  bool int_coefficients(vector<int>& res);
+  bool descendants_by_recurrence(int level, bignum& res, int timelimit);
+  /** the state of descendants_by_recurrence, kept between the calls, so that work cut off by the time limit is continued */
+  vector<bignum> rec_ring;
+  int rec_next;
+  map<int, bignum> rec_results;
+  ld log10_descendants(int level);
   void reset();
   
   expansion_analyzer() { reset(); }
@@ -105,6 +122,7 @@ void expansion_analyzer::preliminary_grouping() {
   samples.clear();
   codeid.clear();
   children.clear();
+  children_mult.clear();
   if(currentmap->strict_tree_rules()) {
     N = isize(rulegen::treestates);
     children.resize(N);
@@ -194,6 +212,7 @@ void expansion_analyzer::reduce_grouping() {
     for(int j: children[groupsample[i]])
       newchildren[i].push_back(grouping[j]);
   children = std::move(newchildren);
+  children_mult.clear();
   for(auto& p: codeid) p.second = grouping[p.second];
   N = nogroups;
   rootid = grouping[rootid];
@@ -214,13 +233,28 @@ bignum& expansion_analyzer::get_descendants(int level) {
 
 bignum& expansion_analyzer::get_descendants(int level, int type) {
   if(!N) preliminary_grouping(), reduce_grouping();
+  if(isize(children_mult) != N) {
+    children_mult.resize(N);
+    for(int i=0; i<N; i++) {
+      auto ch = children[i];
+      sort(ch.begin(), ch.end());
+      children_mult[i].clear();
+      for(int j: ch)
+        if(children_mult[i].empty() || children_mult[i].back().first != j) children_mult[i].emplace_back(j, 1);
+        else children_mult[i].back().second++;
+      }
+    }
   auto& pd = descendants;
   size_upto(pd, level+1);
+  vector<pair<const bignum*, int>> terms;
   for(int d=0; d<=level; d++)
   for(int i=size_upto(pd[d], N); i<N; i++)
     if(d == 0) pd[d][i].be(1);
-    else for(int j: children[i]) 
-      pd[d][i] += pd[d-1][j];
+    else {
+      terms.clear();
+      for(auto& ch: children_mult[i]) terms.emplace_back(&pd[d-1][ch.first], ch.second);
+      pd[d][i].addmul_all(terms);
+      }
   return pd[level][type];
   }
 
@@ -327,6 +361,84 @@ void expansion_analyzer::find_coefficients() {
   coefficients_known = 1;
   }
 
+bool expansion_analyzer::int_coefficients(vector<int>& res) {
+  if(coefficients_known != 2) return false;
+  res.clear();
+  for(auto& x: coef) {
+    #if CAP_GMP
+    if(x.get_den() != 1 || !x.get_num().fits_sint_p()) return false;
+    res.push_back(int(x.get_num().get_si()));
+    #else
+    res.push_back(x);
+    #endif
+    }
+  return true;
+  }
+
+/** a(level) for the root, from the linear recurrence, keeping only the last isize(coef) values;
+ *  much cheaper than extending the descendants table; false if no integer recurrence is known or timelimit (in ms) runs out.
+ *  The results and the progress are kept, so the next call continues where this one stopped */
+bool expansion_analyzer::descendants_by_recurrence(int level, bignum& res, int timelimit) {
+  vector<int> c;
+  if(!int_coefficients(c)) return false;
+  if(level < isize(descendants) || level < valid_from) { res = get_descendants(level); return true; }
+  if(rec_results.count(level)) { res = rec_results[level]; return true; }
+  int k = isize(c);
+  if(rec_ring.empty() || level < rec_next - k) {
+    rec_next = max(isize(descendants), valid_from);
+    rec_ring.assign(k, bignum());
+    for(int t=0; t<k; t++) rec_ring[(rec_next-1-t) % k] = get_descendants(rec_next-1-t);
+    }
+  auto& ring = rec_ring;
+  auto t0 = SDL_GetTicks();
+  vector<pair<const bignum*, int>> positive;
+  for(; rec_next<=level; rec_next++) {
+    if(SDL_GetTicks() > t0 + timelimit) return false;
+    int n = rec_next;
+    positive.clear();
+    for(int t=0; t<k; t++) if(c[t] > 0) positive.emplace_back(&ring[(n-1-t) % k], c[t]);
+    bignum next;
+    next.addmul_all(positive);
+    for(int t=0; t<k; t++) if(c[t] < 0) next.addmul(ring[(n-1-t) % k], c[t]);
+    ring[n % k] = std::move(next);
+    }
+  res = rec_results[level] = ring[level % k];
+  return true;
+  }
+
+/** log10 of a(level) for the root, by raising the companion matrix of the recurrence to a power (rescaled to avoid overflow) */
+ld expansion_analyzer::log10_descendants(int level) {
+  int k = isize(coef);
+  if(coefficients_known != 2 || level < valid_from) return log10(get_descendants(level).approx_ld());
+  typedef vector<vector<ld>> mat;
+  auto mul = [k] (const mat& a, const mat& b, ld& lscale) {
+    mat res(k, vector<ld>(k, 0));
+    ld mx = 0;
+    for(int i=0; i<k; i++) for(int l=0; l<k; l++) if(a[i][l]) for(int j=0; j<k; j++) res[i][j] += a[i][l] * b[l][j];
+    for(auto& row: res) for(auto x: row) mx = max(mx, abs(x));
+    if(mx > 0) { for(auto& row: res) for(auto& x: row) x /= mx; lscale += log10(mx); }
+    return res;
+    };
+  mat comp(k, vector<ld>(k, 0)), pw(k, vector<ld>(k, 0));
+  for(int t=0; t<k; t++) {
+    #if CAP_GMP
+    comp[0][t] = coef[t].get_d();
+    #else
+    comp[0][t] = coef[t];
+    #endif
+    if(t) comp[t][t-1] = 1;
+    pw[t][t] = 1;
+    }
+  ld lcomp = 0, lpw = 0;
+  for(int m = level - valid_from + 1; m; m >>= 1) {
+    if(m & 1) { ld l = lpw + lcomp; pw = mul(pw, comp, l); lpw = l; }
+    if(m > 1) { ld l = 2 * lcomp; comp = mul(comp, comp, l); lcomp = l; }
+    }
+  ld val = 0;
+  for(int t=0; t<k; t++) val += pw[0][t] * get_descendants(valid_from-1-t).approx_ld();
+  return lpw + log10(val);
+  }
+
 ld growth;
 
 ld expansion_analyzer::get_growth() {
@@ -354,8 +466,12 @@ void expansion_analyzer::reset() {
   samples.clear();
   codeid.clear();
   children.clear();
+  children_mult.clear();
   coef.clear();
   descendants.clear();
+  rec_ring.clear();
+  rec_next = 0;
+  rec_results.clear();
   }
 
 EX int type_in(expansion_analyzer& ea, cell *c, const cellfunction& f) {
@@ -377,6 +493,7 @@ EX int type_in(expansion_analyzer& ea, cell *c, const cellfunction& f) {
   
   ea.children.emplace_back();
   ea.children[ret] = get_children_codes(c, f, [&ea, &f] (cell *c1) { return type_in(ea, c1, f); });
+  ea.children_mult.clear();
 
   return ret;
   }
@@ -418,12 +535,23 @@ EX bool trees_known() {
   return sizes_known() && !(BITRUNCATED && a4 && S7 <= 5);
   }
 
+/** called every frame, so the table growth and the recurrence share one budget of 100 ms */
 string expansion_analyzer::approximate_descendants(int d, int max_length) {
   auto t = SDL_GetTicks();
-  while(isize(descendants) <= d && SDL_GetTicks() < t + 100)
+  vector<int> c;
+  bool recurrence = int_coefficients(c);
+  while(isize(descendants) <= d && SDL_GetTicks() < t + 100 && !(recurrence && isize(descendants) >= valid_from))
     get_descendants(isize(descendants));
   if(isize(descendants) > d) 
     return get_descendants(d).get_str(max_length);
+  if(coefficients_known == 2) {
+    bignum b;
+    int left = int(t + 100) - int(SDL_GetTicks());
+    if(left > 0 && descendants_by_recurrence(d, b, left)) return b.get_str(max_length);
+    ld log_10 = log10_descendants(d);
+    int more_digits = int(log_10);
+    return XLAT("about ") + fts(pow(10, log_10 - more_digits)) + "E" + its(more_digits);
+    }
   int v = isize(descendants) - 1;
   bignum& b = get_descendants(v);
   if(b.digits.empty()) return "0";
@@ -928,6 +1056,27 @@ int expansion_readArgs() {
       if(isize(expansion.descendants) >= radius) break;
       }
     }
+  else if(argis("-expansion-bench")) {
+    PHASEFROM(2); 
+    start_game();
+    auto& expansion = get_expansion();
+    shift(); int radius = argi();
+    expansion.find_coefficients();
+    if(expansion.coefficients_known != 2) { println(hlog, "no recurrence found"); return 0; }
+    auto t0 = std::chrono::steady_clock::now();
+    bignum rec;
+    bool ok = expansion.descendants_by_recurrence(radius, rec, 1000000);
+    auto t1 = std::chrono::steady_clock::now();
+    ld lg = expansion.log10_descendants(radius);
+    ld lg_exact = 0;
+    auto t2 = std::chrono::steady_clock::now();
+    bignum& table = expansion.get_descendants(radius);
+    auto t3 = std::chrono::steady_clock::now();
+    if(isize(table.digits)) lg_exact = log10(table.leading()) + 9 * (isize(table.digits) - 1);
+    auto ms = [] (std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b) { return std::chrono::duration<double, std::milli>(b-a).count(); };
+    println(hlog, "radius ", radius, ": table ", ms(t2, t3), " ms, recurrence ", ms(t0, t1), " ms", ok ? (rec < table || table < rec ? " (MISMATCH)" : " (matches)") : " (unavailable)",
+      ", matrix power ", ms(t1, t2), " ms (log10 = ", lg, ", exact ", lg_exact, ")");
+    }
   else if(argis("-csizes")) { 
     PHASEFROM(2); 
     start_game();
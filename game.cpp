@@ -8,6 +8,50 @@
 #include "hyper.h"
 namespace hr {
 
+#if HDR
+/** \brief the SplitMix64 finalizer */
+inline unsigned long long splitmix64(unsigned long long z) {
+  z += 0x9E3779B97F4A7C15ull;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+  }
+
+/** \brief a counter-based random stream
+ *
+ *  The n-th number depends only on the key and on n, so streams with different keys are independent
+ *  of each other and of the order in which they are used, and they can be used by several threads at once.
+ */
+struct rng_stream {
+  using result_type = unsigned;
+  unsigned long long key, counter;
+  rng_stream(unsigned long long k = 0) : key(k), counter(0) {}
+  static constexpr unsigned min() { return 0; }
+  static constexpr unsigned max() { return 0xFFFFFFFFu; }
+  unsigned operator () () { return unsigned(splitmix64(key ^ splitmix64(counter++)) >> 32); }
+  /** \brief an independent stream derived from this one */
+  rng_stream split(unsigned long long sub) const { return rng_stream(splitmix64(key ^ splitmix64(~sub))); }
+  bool operator == (const rng_stream& o) const { return key == o.key && counter == o.counter; }
+  };
+
+/** \brief the type of \link hrngen \endlink: the Mersenne Twister, temporarily replaced by a stream inside rng_scope */
+struct hr_rng {
+  using result_type = unsigned;
+  std::mt19937 mt;
+  rng_stream stream;
+  bool streaming = false;
+  static constexpr unsigned min() { return 0; }
+  static constexpr unsigned max() { return 0xFFFFFFFFu; }
+  unsigned operator () () { return streaming ? stream() : unsigned(mt()); }
+  void seed(unsigned s) { mt.seed(s); streaming = false; }
+  bool operator == (const hr_rng& o) const { return streaming == o.streaming && stream == o.stream && mt == o.mt; }
+  };
+
+template<class T> ld randf_from(T& r) {
+  return (r() - r.min()) / (r.max() + 1.0 - r.min());
+  }
+#endif
+
 /** \brief the main random number generator for the game.
  *  
  * All the random calls related to the game mechanics (land generation, AI...) should use hrngen.
@@ -15,14 +59,186 @@ namespace hr {
  * Random calls not related to the game mechanics (graphical effects) should not use hrngen.
  *
  * This ensures that the game should unfold exactly the same if given the same seed and the same input.
+ *
+ * When rng_streams is on, land generation draws from streams keyed by the cell instead (see rng_scope),
+ * so the main sequence used by the game mechanics does not depend on when the cells are generated.
  */
-EX std::mt19937 hrngen;
+EX hr_rng hrngen;
 
 /** \brief initialize \link hrngen \endlink */
 EX void shrand(int i) {
   hrngen.seed(i);
   }
 
+/** \brief use the keyed streams for land generation; ignored in the daily challenge and in racing, which rely on the classic sequence */
+EX bool rng_streams = false;
+
+/** \brief the seed of the keyed streams, drawn from hrngen at the start of every game */
+EX unsigned long long stream_seed;
+
+/** \brief are the keyed streams used in the current game; rng_streams is checked when the game starts */
+EX bool streams_in_game = false;
+
+/** \brief should everything use the main sequence, as in the older versions */
+EX bool rng_compat() { return !streams_in_game; }
+
+/** ids of cells and heptagons for the keyed streams; the heptagon ids remember c7, so that they can be removed with their cells */
+std::unordered_map<cell*, unsigned long long> cell_ids;
+std::unordered_map<heptagon*, pair<unsigned long long, cell*>> heptagon_ids;
+unsigned long long next_fallback_id;
+#if CAP_THREAD
+std::mutex rng_ids_lock;
+#endif
+
+/** \brief called when a new game starts */
+EX void init_rng_streams() {
+  cell_ids.clear(); heptagon_ids.clear(); next_fallback_id = 0;
+  streams_in_game = rng_streams;
+  #if CAP_DAILY
+  if(daily::on) streams_in_game = false;
+  #endif
+  #if CAP_RACING
+  if(racing::on) streams_in_game = false;
+  #endif
+  stream_seed = streams_in_game ? hrngen() : 0;
+  }
+
+/** \brief the key of the stream with the given name, for the given object */
+EX unsigned long long stream_key(const char *name, unsigned long long id, unsigned long long sub) {
+  unsigned long long h = 0xCBF29CE484222325ull;
+  for(const char *s = name; *s; s++) h = (h ^ (unsigned char) *s) * 0x100000001B3ull;
+  return splitmix64(splitmix64(stream_seed ^ h) ^ splitmix64(id)) ^ splitmix64(~sub);
+  }
+
+#if HDR
+unsigned long long stream_key(const char *name, unsigned long long id, unsigned long long sub = 0);
+unsigned long long cell_rng_id(cell *c);
+bool rng_compat();
+
+/** \brief while this exists, hrngen draws from the named stream of the given cell (or other object); nothing changes in the compatibility mode */
+struct rng_scope {
+  bool active;
+  rng_stream old_stream;
+  bool old_streaming;
+  void enter(const char *name, unsigned long long id, unsigned long long sub) {
+    old_stream = hrngen.stream; old_streaming = hrngen.streaming;
+    hrngen.stream = rng_stream(stream_key(name, id, sub)); hrngen.streaming = true;
+    }
+  rng_scope(const char *name, unsigned long long id, unsigned long long sub = 0) : active(!rng_compat()) { if(active) enter(name, id, sub); }
+  rng_scope(const char *name, cell *c, unsigned long long sub = 0) : active(!rng_compat()) { if(active) enter(name, cell_rng_id(c), sub); }
+  ~rng_scope() { if(active) hrngen.stream = old_stream, hrngen.streaming = old_streaming; }
+  rng_scope(const rng_scope&) = delete;
+  rng_scope& operator = (const rng_scope&) = delete;
+  };
+#endif
+
+/** ids given in the order of the requests, where the structure gives none */
+unsigned long long fallback_rng_id() { return splitmix64(0xFA11BAC4ull + next_fallback_id++); }
+
+unsigned long long heptagon_rng_id(heptagon *h) {
+  vector<pair<heptagon*, int>> chain;
+  unsigned long long id;
+  while(true) {
+    auto it = heptagon_ids.find(h);
+    if(it != heptagon_ids.end()) { id = it->second.first; break; }
+    if(h == currentmap->getOrigin()) { id = splitmix64(0x0816); break; }
+    /* in the tree-based tilings, move(0) leads towards the origin */
+    heptagon *p = h->move(0);
+    if(!p || p->distance >= h->distance) { id = fallback_rng_id(); break; }
+    chain.emplace_back(h, h->c.spin(0));
+    h = p;
+    }
+  heptagon_ids[h] = make_pair(id, h->c7);
+  while(!chain.empty()) {
+    id = splitmix64(id ^ splitmix64(chain.back().second + 1));
+    heptagon_ids[chain.back().first] = make_pair(id, chain.back().first->c7);
+    chain.pop_back();
+    }
+  return id;
+  }
+
+/** \brief the id of c for stream_key
+ *
+ *  In the tilings where the heptagons form a tree, it depends only on the position of c, so the
+ *  cells get the same streams whatever the order of generation; elsewhere it depends on the order of the first requests.
+ */
+EX unsigned long long cell_rng_id(cell *c) {
+  #if CAP_THREAD
+  std::unique_lock<std::mutex> lk(rng_ids_lock);
+  #endif
+  auto it = cell_ids.find(c);
+  if(it != cell_ids.end()) return it->second;
+  unsigned long long id;
+  heptagon *h = currentmap->getOrigin() ? c->master : nullptr;
+  if(!h || !h->c7) id = fallback_rng_id();
+  else if(c == h->c7) id = heptagon_rng_id(h);
+  else {
+    int dir = -1;
+    for(int i=0; i<h->c7->type; i++) if(h->c7->move(i) == c) { dir = i; break; }
+    id = dir >= 0 ? splitmix64(heptagon_rng_id(h) ^ splitmix64(1000 + dir)) : fallback_rng_id();
+    }
+  return cell_ids[c] = id;
+  }
+
+/** \brief check the random streams: prints the results and the speed */
+EX void rng_test() {
+  hr_rng a; a.seed(1234);
+  std::mt19937 b(1234);
+  bool same = true;
+  for(int i=0; i<10000; i++) if(a() != b()) same = false;
+  println(hlog, "rng: compatibility sequence ", same ? "(ok)" : "(WRONG)");
+
+  int n = 1<<16;
+  vector<unsigned> serial(n), parallel(n);
+  for(int i=0; i<n; i++) { rng_stream s(stream_key("test", i)); s(); serial[i] = s(); }
+  jobs::parallel_for(n, [&] (int i) { rng_stream s(stream_key("test", i)); s(); parallel[i] = s(); });
+  println(hlog, "rng: keyed streams in parallel ", serial == parallel ? "(ok)" : "(WRONG)");
+
+  dynamicval<bool> ds(streams_in_game, true);
+  hr_rng saved = hrngen;
+  vector<int> v1, v2;
+  { rng_scope s("test", 1); for(int i=0; i<10; i++) v1.push_back(hrand(1000)); }
+  { rng_scope s("test", 1); for(int i=0; i<10; i++) v2.push_back(hrand(1000)); }
+  println(hlog, "rng: scopes repeat ", v1 == v2 ? "(ok)" : "(WRONG)", ", main sequence untouched ", hrngen == saved ? "(ok)" : "(WRONG)");
+
+  auto speed = [] (const string& name, const function<unsigned()>& f) {
+    auto t0 = std::chrono::steady_clock::now();
+    unsigned x = 0;
+    for(int i=0; i<10000000; i++) x += f();
+    int ms = int(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count());
+    println(hlog, "rng: 10M numbers from ", name, " in ", ms, " ms (", int(x & 1), ")");
+    };
+  speed("the main sequence", [&] { return a(); });
+  rng_stream s(stream_key("test", 0));
+  speed("a stream", [&] { return s(); });
+  }
+
+auto rng_hooks = addHook(hooks_clearmemory, 0, [] { cell_ids.clear(); heptagon_ids.clear(); })
+  + addHook(hooks_removecells, 0, [] {
+    for(auto it = cell_ids.begin(); it != cell_ids.end();)
+      if(is_cell_removed(it->first)) it = cell_ids.erase(it); else ++it;
+    for(auto it = heptagon_ids.begin(); it != heptagon_ids.end();)
+      if(is_cell_removed(it->second.second)) it = heptagon_ids.erase(it); else ++it;
+    })
+  + addHook(hooks_configfile, 100, [] {
+    param_b(rng_streams, "rng_streams", false)
+    ->editable("independent random streams", 'R')
+    ->help("Generate the lands from random streams keyed by the cells, so that the generated lands do not depend on when the cells are generated, and the game mechanics do not depend on how many cells are generated. Games played with this setting differ from the older versions. Not used in the daily challenge and racing. Takes effect in the next game.");
+    })
+#if CAP_COMMANDLINE
+  + addHook(hooks_args, 100, [] {
+    using namespace arg;
+    if(0) ;
+    else if(argis("-rng-streams")) {
+      shift(); rng_streams = argi();
+      }
+    else if(argis("-rng-test")) rng_test();
+    else return 1;
+    return 0;
+    })
+#endif
+  ;
+
 /** \brief generate a large number with \link hrngen \endlink */
 EX int hrandpos() { return hrngen() & HRANDMAX; }
 
@@ -62,16 +278,12 @@ EX vector<int> hrandom_permutation(int qty) {
 /** Use \link hrngen \endlink to generate a floating point number between 0 and 1.
  */
 
-EX ld randf_from(std::mt19937& r) { 
-  return (r() - r.min()) / (r.max() + 1.0 - r.min());
-  }
-
 EX ld hrandf() { return randf_from(hrngen); }
 
 /** Returns an integer corresponding to the current state of \link hrngen \endlink.
  */
 EX int hrandstate() {
-  std::mt19937 r2 = hrngen;
+  hr_rng r2 = hrngen;
   return r2() & HRANDMAX;
   }
 
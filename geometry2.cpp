@@ -738,7 +738,7 @@ EX hyperpoint farcorner(cell *c, int i, int which) {
     int spin = vs.spin[i];
     auto &vs2 = irr::cells[neid];
     int cor2 = isize(vs2.vertices);
-    transmatrix rel = vs.rpusher * vs.relmatrices[vs2.owner] * vs2.pusher;
+    transmatrix rel = vs.rpusher * vs.relmatrices[vs2.owner_id] * vs2.pusher;
 
     if(which == 0) return rel * vs2.vertices[(spin+2)%cor2];
     if(which == 1) return rel * vs2.vertices[(spin+cor2-1)%cor2];
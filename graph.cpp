@@ -1360,6 +1360,7 @@ EX void center_multiplayer_map(const vector<hyperpoint>& hs) {
   }
 
 EX void drawthemap() {
+  PROFILE("drawthemap");
   check_cgi();
   cgi.require_shapes();
 
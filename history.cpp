@@ -441,6 +441,81 @@ EX namespace history {
 #endif
 
 #if CAP_SDL
+  /** how many finished band segments may wait for encoding; the renderer blocks when this is exceeded */
+  EX int band_queue_limit = 2;
+
+  /** the spiral keeps a copy of the whole band, downscaled so that it does not exceed this many pixels */
+  EX int spiral_max_pixels = 16000000;
+
+  /** band segments are encoded and saved in a separate thread while the next segment is rendered */
+  struct band_writer {
+    struct job { SDL_Surface *srf; string fname; bool release; };
+
+    void run(const job& j) {
+      if(j.fname != "") IMAGESAVE(j.srf, j.fname.c_str());
+      if(j.release) SDL_DestroySurface(j.srf);
+      }
+
+    #if CAP_THREAD
+    std::mutex lock;
+    std::condition_variable cv;
+    queue<job> jobs;
+    bool finished = false;
+    std::thread worker;
+
+    band_writer() {
+      worker = std::thread([this] {
+        while(true) {
+          std::unique_lock<std::mutex> lk(lock);
+          cv.wait(lk, [this] { return finished || !jobs.empty(); });
+          if(jobs.empty()) return;
+          job j = jobs.front();
+          lk.unlock();
+          run(j);
+          lk.lock();
+          jobs.pop();
+          cv.notify_all();
+          }
+        });
+      }
+
+    void save(SDL_Surface *srf, const string& fname, bool release) {
+      std::unique_lock<std::mutex> lk(lock);
+      cv.wait(lk, [this] { return isize(jobs) < max(band_queue_limit, 1); });
+      jobs.push(job{srf, fname, release});
+      cv.notify_all();
+      }
+
+    void finish() {
+      if(!worker.joinable()) return;
+      { std::unique_lock<std::mutex> lk(lock); finished = true; cv.notify_all(); }
+      worker.join();
+      }
+
+    ~band_writer() { finish(); }
+    #else
+    void save(SDL_Surface *srf, const string& fname, bool release) { run(job{srf, fname, release}); }
+    void finish() {}
+    #endif
+    };
+
+  /** box-filter a band segment for the spiral */
+  SDL_Surface *downscale_band(SDL_Surface *band, int scale) {
+    int w = band->w / scale, h = band->h / scale;
+    SDL_Surface *res = SDL_CreateRGBSurface(SDL_SWSURFACE, max(w, 1), max(h, 1), 32,0,0,0,0);
+    if(!res) return nullptr;
+    for(int y=0; y<h; y++) for(int x=0; x<w; x++) {
+      int sum[4] = {0, 0, 0, 0};
+      for(int dy=0; dy<scale; dy++) for(int dx=0; dx<scale; dx++) {
+        color_t col = qpixel(band, x*scale+dx, y*scale+dy);
+        for(int p=0; p<4; p++) sum[p] += part(col, p);
+        }
+      color_t& tgt = qpixel(res, x, y);
+      for(int p=0; p<4; p++) part(tgt, p) = sum[p] / (scale * scale);
+      }
+    return res;
+    }
+
   EX void createImage(const string& name_format, bool dospiral) {
     int segid = 1;
     if(includeHistory) restore();
@@ -454,7 +529,15 @@ EX namespace history {
     strftime(timebuf, 128, "%y%m%d-%H%M%S", localtime(&timer));
 
     vector<SDL_Surface*> bands;
-    
+
+    /* the spiral needs the whole band at once, so its copy is downscaled to keep the memory bounded */
+    int spiral_scale = 1;
+    if(dospiral)
+      while((len / spiral_scale + 1) * (bandfull / spiral_scale) > spiral_max_pixels && spiral_scale < bandfull)
+        spiral_scale++;
+
+    band_writer writer;
+
     resetbuffer rbuf;
     
     if(1) {
@@ -483,12 +566,18 @@ EX namespace history {
         string fname = name_format;
         replace_str(fname, "$DATE", timebuf);
         replace_str(fname, "$ID", hr::format("%03d", segid++));
-        IMAGESAVE(band, fname.c_str());
 
-        if(dospiral) 
+        if(dospiral && spiral_scale == 1) {
           bands.push_back(band);
-        else 
-          SDL_DestroySurface(band);
+          writer.save(band, fname, false);
+          }
+        else {
+          if(dospiral) {
+            SDL_Surface *small = downscale_band(band, spiral_scale);
+            if(small) bands.push_back(small);
+            }
+          writer.save(band, fname, true);
+          }
         };
       
       if(!band) {
@@ -543,6 +632,8 @@ EX namespace history {
               band = SDL_CreateRGBSurface(SDL_SWSURFACE, seglen, bandfull,32,0,0,0,0);
               if(!band) {
                 addMessage(XLAT("Could not create an image of that size."));
+                writer.finish();
+                for(auto b: bands) SDL_DestroySurface(b);
                 return;
                 }
               goto drawsegment;
@@ -558,6 +649,7 @@ EX namespace history {
       save_band_segment();
       }
 
+    writer.finish();
     rbuf.reset();
 
     if(includeHistory) restoreBack();
@@ -771,6 +863,10 @@ EX namespace history {
     param_b(autoband, "automatic band");
     param_b(autobandhistory, "automatic band history");
     param_b(dospiral, "do spiral");
+    #if CAP_SDL
+    param_i(band_queue_limit, "band queue limit");
+    param_i(spiral_max_pixels, "spiral max pixels");
+    #endif
 
     #if CAP_SHOT && CAP_SDL
     param_str(band_format_auto, "band_format_auto");
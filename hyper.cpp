@@ -29,6 +29,7 @@
 #include "raycaster.cpp"
 #include "hprint.cpp"
 #include "util.cpp"
+#include "jobs.cpp"
 #include "hyperpoint.cpp"
 #include "patterns.cpp"
 #include "fieldpattern.cpp"
@@ -79,6 +80,7 @@
 #include "inventory.cpp"
 #include "system.cpp"
 #include "debug.cpp"
+#include "profiler.cpp"
 #include "geometry.cpp"
 #include "embeddings.cpp"
 #include "geometry2.cpp"
@@ -93,6 +95,7 @@
 #include "basegraph.cpp"
 #include "screenshot.cpp"
 #include "renderbuffer.cpp"
+#include "rasterizer.cpp"
 #include "help.cpp"
 #include "legacy.cpp"
 #include "config.cpp"
@@ -135,6 +138,7 @@
 #include "crossbow.cpp"
 #include "fundamental.cpp"
 #include "archipelago.cpp"
+#include "archipelago-io.cpp"
 
 #if CAP_ROGUEVIZ
 #include "rogueviz/rogueviz-all.cpp"
@@ -1506,18 +1506,18 @@ EX void apply_other_model(shiftpoint H_orig, hyperpoint& ret, eModel md) {
     case mdFormula: {
       dynamicval<eModel> m(pmodel, pconf.basic_model);
       applymodel(H_orig, ret);
-      exp_parser ep;
-      ep.extra_params["z"] = cld(ret[0], ret[1]);
-      ep.extra_params["cx"] = ret[0];
-      ep.extra_params["cy"] = ret[1];
-      ep.extra_params["cz"] = ret[2];
-      ep.extra_params["ux"] = H[0];
-      ep.extra_params["uy"] = H[1];
-      ep.extra_params["uz"] = H[2];
-      ep.s = pconf.formula;
       cld res;
       try {
-        res = ep.parse();
+        static const vector<string> inputs = {"z", "cx", "cy", "cz", "ux", "uy", "uz"};
+        auto f = cached_formula(pconf.formula, inputs);
+        f->slots[0] = cld(ret[0], ret[1]);
+        f->slots[1] = ret[0];
+        f->slots[2] = ret[1];
+        f->slots[3] = ret[2];
+        f->slots[4] = H[0];
+        f->slots[5] = H[1];
+        f->slots[6] = H[2];
+        res = f->eval();
         }
       catch(hr_parse_exception&) {
         res = 0;
@@ -21,10 +21,19 @@ EX int rearrange_less = 10;
 
 EX int cellcount;
 
+/** number of threads used by the relaxation passes (0 = hardware concurrency) */
+EX int threads = 0;
+
+/** number of Voronoi passes done in the current map creation */
+EX int relaxations;
+
 #if HDR
 struct cellinfo {
   cell *owner;
-  map<cell*, transmatrix> relmatrices;
+  /** index of owner in base->allcells() */
+  int owner_id;
+  /** relmatrices[k] is the relative matrix of base->allcells()[k] */
+  vector<transmatrix> relmatrices;
   vector<hyperpoint> jpoints;
   hyperpoint p;
   transmatrix pusher, rpusher;
@@ -76,8 +85,17 @@ int black_adjacent, white_three;
 
 void set_relmatrices(cellinfo& ci) {
   auto& all = base->allcells();
-  ci.relmatrices.clear();
-  for(auto c0: all) ci.relmatrices[c0] = calc_relative_matrix(c0, ci.owner, ci.p);
+  ci.relmatrices.resize(isize(all));
+  ci.owner_id = -1;
+  for(int k=0; k<isize(all); k++) {
+    ci.relmatrices[k] = calc_relative_matrix(all[k], ci.owner, ci.p);
+    if(all[k] == ci.owner) ci.owner_id = k;
+    }
+  }
+
+/** call f(i) for every i in [0,n), on the job system */
+template<class T> void parallel_cells(int n, const T& f) {
+  jobs::parallel_for(n, f, n < 64 ? 1 : threads);
   }
 
 void rebase(cellinfo& ci) {
@@ -90,19 +108,20 @@ void rebase(cellinfo& ci) {
   }
 
 void compute_jpoints() {
-  for(int i=0; i<isize(cells); i++) {
+  int N = isize(cells);
+  parallel_cells(N, [N] (int i) {
     auto &ci = cells[i];
 
     ci.pusher = rgpushxto0(ci.p);
     ci.rpusher = gpushxto0(ci.p);
     
-    ci.jpoints.clear();
+    ci.jpoints.resize(N);
 
-    for(int j=0; j<isize(cells); j++) {
+    for(int j=0; j<N; j++) {
       auto &cj = cells[j];
-      ci.jpoints.push_back(ci.rpusher * ci.relmatrices[cj.owner] * cj.p);
+      ci.jpoints[j] = ci.rpusher * ci.relmatrices[cj.owner_id] * cj.p;
       }
-    }
+    });
   }
     
 void bitruncate() {
@@ -152,7 +171,7 @@ void bitruncate() {
     }
   make_cells_of_heptagon();
   compute_jpoints();
-  for(int i=0; i<isize(cells); i++) {
+  parallel_cells(isize(cells), [] (int i) {
     auto &ci = cells[i];
     ci.vertices.clear();
 
@@ -163,18 +182,18 @@ void bitruncate() {
     for(int j=0; j<v; j++) {
       int last = ci.neid[(j+v-1)%v];
       int next = ci.neid[j];
-      hyperpoint h1 = ci.rpusher * ci.relmatrices[cells[last].owner] * cells[last].p;
-      hyperpoint h2 = ci.rpusher * ci.relmatrices[cells[next].owner] * cells[next].p;
+      hyperpoint h1 = ci.rpusher * ci.relmatrices[cells[last].owner_id] * cells[last].p;
+      hyperpoint h2 = ci.rpusher * ci.relmatrices[cells[next].owner_id] * cells[next].p;
       ci.vertices.push_back(mid3(C0, h1, h2));
       }
-    }
+    });
   bitruncations_performed++;
   cell_sorting = false;
   }
 
 int rearrange(bool total, ld minedge) {
-  int tooshort = 0;
-  for(int i=0; i<isize(cells); i++) {
+  vector<int> tooshort(isize(cells), 0);
+  parallel_cells(isize(cells), [&] (int i) {
     auto& p1 = cells[i];
     hyperpoint h = Hypc;
     for(auto v: p1.vertices) h = h + v;
@@ -183,13 +202,15 @@ int rearrange(bool total, ld minedge) {
 
     for(int j=0; j<isize(p1.vertices); j++)
       if(hdist(p1.vertices[j], p1.vertices[(j+1) % isize(p1.vertices)]) < minedge) {
-        tooshort++; changed = true;
+        tooshort[i]++; changed = true;
         h = h + p1.vertices[j] + p1.vertices[(j+1) % isize(p1.vertices)];
         }
     if(changed)
       cells[i].p = p1.pusher * normalize(h);
-    }
-  return tooshort;
+    });
+  int total_tooshort = 0;
+  for(int t: tooshort) total_tooshort += t;
+  return total_tooshort;
   }
 
 bool step(int delta) {
@@ -207,6 +228,7 @@ bool step(int delta) {
      cells.clear();
      cells_of_heptagon.clear();
      cellindex.clear();
+     relaxations = 0;
      
      if(0) if(cellcount <= isize(all) * 2) {
        for(auto h: all) {
@@ -232,16 +254,17 @@ bool step(int delta) {
         for(int j=0; j<place_attempts; j++) {
           int k = hrand(isize(all));
           cell *c = all[k];
-          map<cell*, transmatrix> relmatrices;
+          vector<transmatrix> relmatrices(isize(all));
           hyperpoint h = randomPointIn(c->type);
-          for(auto c0: all) relmatrices[c0] = calc_relative_matrix(c0, c, h);
+          for(int k1=0; k1<isize(all); k1++) relmatrices[k1] = calc_relative_matrix(all[k1], c, h);
           ld mindist = 1e6;
-          for(auto p: cells) {
-            if(!relmatrices.count(p.owner)) continue;
-            ld val = hdist(h, relmatrices[p.owner] * p.p);
+          /* s itself is included once it has a candidate, as the maps of the older versions depend on that */
+          for(auto& p: cells) {
+            if(!p.owner) continue;
+            ld val = hdist(h, relmatrices[p.owner_id] * p.p);
             if(val < mindist) mindist = val;
             }
-          if(mindist > bestval) bestval = mindist, s.owner = c, s.p = h, s.relmatrices = std::move(relmatrices);
+          if(mindist > bestval) bestval = mindist, s.owner = c, s.owner_id = k, s.p = h, s.relmatrices = std::move(relmatrices);
           }
         }
       make_cells_of_heptagon();
@@ -264,8 +287,9 @@ bool step(int delta) {
       for(int k=0; k<16; k++) stats[k] = 0;
       
       compute_jpoints();
+      relaxations++;
       
-      for(int i=0; i<isize(cells); i++) {
+      parallel_cells(isize(cells), [] (int i) {
         auto &p1 = cells[i];
     
         p1.vertices.clear();
@@ -297,13 +321,15 @@ bool step(int delta) {
             }
           p1.vertices.push_back(best_h);
           p1.neid.push_back(best_k);
-          distlens.push_back(hdist0(best_h));
           oldj = j, j = best_k, t = best_h;
           if(j == -1) break;
           if(isize(p1.vertices) == 15) break;
           }
         while(j != j0);
-        
+        });
+
+      for(auto& p1: cells) {
+        for(auto& v: p1.vertices) distlens.push_back(hdist0(v));
         for(int j=0; j<isize(p1.vertices); j++)
           edgelens.push_back(hdist(p1.vertices[j], p1.vertices[(j+1) % isize(p1.vertices)]));
     
@@ -867,8 +893,8 @@ bool load_map(const string &fname) {
       double a, b, c;
       scan(f, a, b, c);
       s.p = hpxyz(a, b, c);
-      for(auto c0: all) s.relmatrices[c0] = calc_relative_matrix(c0, h, s.p);
       s.owner = h;
+      set_relmatrices(s);
       }
     }
 
@@ -907,8 +933,8 @@ EX void load_map_bin(hstream& f) {
       float_order.push_back(c);
       s.p = hpxyz(a, b, c);
       s.p = normalize(s.p);
-      for(auto c0: all) s.relmatrices[c0] = calc_relative_matrix(c0, h, s.p);
       s.owner = h;
+      set_relmatrices(s);
       }
     }
 
@@ -1079,7 +1105,10 @@ EX void auto_creator() {
   visual_creator();
   cellcount = cc; density = cc * 1. / isize(base->allcells());
   printf("Creating the irregular map automatically...\n");
+  auto t0 = std::chrono::steady_clock::now();
   while(runlevel < 10) step(1000);
+  ld secs = std::chrono::duration<ld>(std::chrono::steady_clock::now() - t0).count();
+  printf("created in %.3f s, %d relaxation passes (%.2f iterations/sec)\n", double(secs), relaxations, double(secs > 0 ? relaxations / secs : 0));
   start_game_on_created_map();
   }
 
@@ -1102,6 +1131,9 @@ int readArgs() {
     PHASEFROM(2);
     shift(); bitruncations_requested = argi();
     }
+  else if(argis("-irr-threads")) {
+    shift(); threads = argi();
+    }
   else if(argis("-irrq")) {
     PHASEFROM(2);
     shift_arg_formula(quality);
@@ -1156,7 +1188,7 @@ EX void swap_vertices() {
     swapmatrix(c.pusher);
     swapmatrix(c.rpusher);
     for(auto& jp: c.jpoints) swappoint(jp);
-    for(auto& rm: c.relmatrices) swapmatrix(rm.second);
+    for(auto& rm: c.relmatrices) swapmatrix(rm);
     for(auto& v: c.vertices) swappoint(v);
     }
   }
@@ -314,11 +314,11 @@ EX bool collectItem(cell *c2, cell *last, bool telekinesis IS(false)) {
 
     // ARCHIPELAGO: If the item is an Orb of Yendor, win. (TODO: add other goal conditions)
     if (c2->item == itOrbYendor) {
-      ap::sendYendor();
+      apq::post_yendor();
     }
     // ARCHIPELAGO: Try to send treasure check if treasure >= 10;
-    if (ap::apIsEnabled() && items[c2->item] >= 10) {
-      ap::trySendTreasure(c2->item);
+    if (items[c2->item] >= 10) {
+      apq::post_treasure(c2->item);
     }
 
     if(c2->item && items[c2->item] > q && (vid.bubbles_all || (threshold_met(items[c2->item]) > threshold_met(q) && vid.bubbles_threshold))) {
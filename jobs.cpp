@@ -0,0 +1,308 @@
+// Hyperbolic Rogue -- the job system
+// Copyright (C) 2011-2019 Zeno Rogue, see 'hyper.cpp' for details
+
+/** \file jobs.cpp
+ *  \brief a pool of worker threads shared by all the subsystems which compute in parallel
+ *
+ *  Every worker has its own queue; a worker takes the jobs from its own queue first (newest first),
+ *  and steals the oldest job from another queue when its own is empty. A thread waiting for a job
+ *  runs other queued jobs in the meantime, so jobs may wait for other jobs without deadlocking.
+ *  Without CAP_THREAD, every job is run at once by the thread which submits it.
+ */
+
+#include "hyper.h"
+namespace hr {
+
+#if HDR
+namespace jobs {
+
+/** jobs checking a cancelled token stop early; jobs submitted with it are not started */
+struct cancel_token {
+  #if CAP_THREAD
+  shared_ptr<std::atomic<bool>> flag = make_shared<std::atomic<bool>>(false);
+  #else
+  shared_ptr<bool> flag = make_shared<bool>(false);
+  #endif
+  void cancel() { *flag = true; }
+  bool cancelled() const { return *flag; }
+  };
+
+struct job_state;
+/** a handle to a submitted job */
+using job = shared_ptr<job_state>;
+
+int pool_size();
+job submit(const function<void()>& f, const vector<job>& after = {}, cancel_token *token = nullptr);
+bool finished(const job& j);
+void wait(const job& j);
+void run_parallel(int n, const function<void(int)>& f, int max_threads = 0);
+
+/** the result of a job which computes a value */
+template<class T> struct future {
+  job j;
+  shared_ptr<T> result;
+  bool ready() const { return finished(j); }
+  T& get() { wait(j); return *result; }
+  };
+
+/** run f as a job, after all the jobs in `after` have finished */
+template<class T> future<T> async(const function<T()>& f, const vector<job>& after = {}) {
+  future<T> res;
+  res.result = make_shared<T>();
+  auto r = res.result;
+  res.j = submit([r, f] { *r = f(); }, after);
+  return res;
+  }
+
+/** call f(k) for k in [0,n) in parallel, using at most max_threads threads (0 = the pool size); stop early if token is cancelled */
+template<class T> void parallel_for(int n, const T& f, int max_threads = 0, cancel_token *token = nullptr) {
+  int nt = max_threads ? min(max_threads, pool_size()) : pool_size();
+  /* contiguous chunks, several per thread, so that uneven work is balanced */
+  int chunks = min(n, nt == 1 ? 1 : nt * 4);
+  if(chunks <= 0) return;
+  auto work = [&] (int k) {
+    if(token && token->cancelled()) return;
+    for(int i=int(n*1ll*k/chunks); i<int(n*1ll*(k+1)/chunks); i++) f(i);
+    };
+  if(chunks == 1) { work(0); return; }
+  run_parallel(chunks, work, nt);
+  }
+
+/** call f(c) for every cell in v, in parallel */
+template<class T> void parallel_for_cells(const vector<cell*>& v, const T& f, int max_threads = 0, cancel_token *token = nullptr) {
+  parallel_for(isize(v), [&] (int i) { f(v[i]); }, max_threads, token);
+  }
+}
+#endif
+
+EX namespace jobs {
+
+/** the number of threads computing jobs, including the one which waits; 0 = all the hardware threads */
+EX int threads = 0;
+
+#if CAP_THREAD
+struct job_state {
+  function<void()> f;
+  cancel_token token;
+  bool has_token;
+  /** dependencies not yet finished, plus one until the job is submitted */
+  std::atomic<int> blockers;
+  std::atomic<bool> done;
+  std::mutex lock;
+  /** jobs waiting for this one; guarded by lock */
+  vector<job> dependents;
+  };
+
+struct worker_queue {
+  std::mutex lock;
+  std::deque<job> jobs;
+  };
+
+vector<std::unique_ptr<worker_queue>> queues;
+vector<std::thread> workers;
+std::mutex sleep_lock;
+std::condition_variable sleep_cv;
+std::atomic<int> queued(0);
+std::atomic<unsigned> next_queue(0);
+bool stopping = false;
+int running_threads = 0;
+
+/** the queue of the current worker thread, or -1 outside of the workers */
+thread_local int my_queue = -1;
+
+void enqueue(const job& j) {
+  int q = my_queue >= 0 ? my_queue : int(next_queue++ % queues.size());
+  {
+    std::unique_lock<std::mutex> lk(queues[q]->lock);
+    queues[q]->jobs.push_back(j);
+  }
+  queued++;
+  std::unique_lock<std::mutex> lk(sleep_lock);
+  sleep_cv.notify_one();
+  }
+
+/** take a job: from our own queue first, then steal from the others */
+job take() {
+  if(!queued) return nullptr;
+  int n = isize(queues);
+  int start = my_queue >= 0 ? my_queue : 0;
+  for(int i=0; i<n; i++) {
+    int q = (start + i) % n;
+    std::unique_lock<std::mutex> lk(queues[q]->lock);
+    auto& d = queues[q]->jobs;
+    if(d.empty()) continue;
+    job j;
+    if(q == my_queue) j = d.back(), d.pop_back();
+    else j = d.front(), d.pop_front();
+    queued--;
+    return j;
+    }
+  return nullptr;
+  }
+
+void run(const job& j) {
+  if(!(j->has_token && j->token.cancelled())) j->f();
+  j->f = function<void()>();
+  vector<job> ready;
+  {
+    std::unique_lock<std::mutex> lk(j->lock);
+    j->done = true;
+    for(auto& d: j->dependents) if(--d->blockers == 0) ready.push_back(d);
+    j->dependents.clear();
+  }
+  { std::unique_lock<std::mutex> lk(sleep_lock); sleep_cv.notify_all(); }
+  for(auto& d: ready) enqueue(d);
+  }
+
+void worker_loop(int id) {
+  my_queue = id;
+  while(true) {
+    job j = take();
+    if(j) { run(j); continue; }
+    std::unique_lock<std::mutex> lk(sleep_lock);
+    if(stopping) return;
+    sleep_cv.wait(lk, [] { return stopping || queued > 0; });
+    if(stopping) return;
+    }
+  }
+
+void start() {
+  if(running_threads) return;
+  int nt = threads ? threads : std::thread::hardware_concurrency();
+  if(nt < 1) nt = 1;
+  running_threads = nt;
+  stopping = false;
+  /* the thread which waits also computes, so one worker fewer is needed */
+  queues.clear();
+  for(int i=0; i<nt; i++) queues.emplace_back(new worker_queue);
+  for(int i=1; i<nt; i++) workers.emplace_back(worker_loop, i);
+  }
+
+/** stop the workers; jobs still queued are run by the caller first */
+EX void stop() {
+  if(!running_threads) return;
+  while(job j = take()) run(j);
+  { std::unique_lock<std::mutex> lk(sleep_lock); stopping = true; sleep_cv.notify_all(); }
+  for(auto& w: workers) w.join();
+  workers.clear();
+  running_threads = 0;
+  }
+
+EX int pool_size() {
+  if(my_queue > 0) return running_threads;
+  start();
+  return running_threads;
+  }
+
+EX job submit(const function<void()>& f, const vector<job>& after, cancel_token *token) {
+  start();
+  job j = make_shared<job_state>();
+  j->f = f;
+  j->has_token = token;
+  if(token) j->token = *token;
+  j->blockers = 1;
+  j->done = false;
+  for(auto& a: after) {
+    std::unique_lock<std::mutex> lk(a->lock);
+    if(a->done) continue;
+    j->blockers++;
+    a->dependents.push_back(j);
+    }
+  if(--j->blockers == 0) enqueue(j);
+  return j;
+  }
+
+EX bool finished(const job& j) { return j->done; }
+
+/** wait until j is finished, running other jobs in the meantime */
+EX void wait(const job& j) {
+  while(!j->done) {
+    job other = take();
+    if(other) { run(other); continue; }
+    std::unique_lock<std::mutex> lk(sleep_lock);
+    sleep_cv.wait_for(lk, std::chrono::milliseconds(1), [&] { return j->done || queued > 0; });
+    }
+  }
+
+/** call f(k) for k in [0,n), using at most max_threads threads including this one (0 = the pool size) */
+EX void run_parallel(int n, const function<void(int)>& f, int max_threads) {
+  int nt = max_threads ? min(max_threads, pool_size()) : pool_size();
+  if(nt == 1) { for(int k=0; k<n; k++) f(k); return; }
+  /* the chunks are claimed in order, by the helpers and by this thread */
+  auto next = make_shared<std::atomic<int>>(0);
+  auto claim = [next, n, &f] { while(true) { int k = (*next)++; if(k >= n) return; f(k); } };
+  vector<job> helpers;
+  for(int i=1; i<min(n, nt); i++) helpers.push_back(submit(claim));
+  claim();
+  for(auto& h: helpers) wait(h);
+  }
+
+#else
+struct job_state {};
+
+EX int pool_size() { return 1; }
+
+EX job submit(const function<void()>& f, const vector<job>& after, cancel_token *token) {
+  if(!(token && token->cancelled())) f();
+  return make_shared<job_state>();
+  }
+
+EX bool finished(const job& j) { return true; }
+EX void wait(const job& j) {}
+EX void run_parallel(int n, const function<void(int)>& f, int max_threads) { for(int k=0; k<n; k++) f(k); }
+EX void stop() {}
+#endif
+
+/** check the job system: prints the results and the time taken */
+EX void test() {
+  auto t0 = std::chrono::steady_clock::now();
+  int n = 1000000;
+  vector<int> v(n);
+  parallel_for(n, [&] (int i) { v[i] = i % 7; });
+  long long sum = 0; for(int x: v) sum += x;
+  println(hlog, "jobs: ", pool_size(), " threads, parallel_for sum ", int(sum), sum == 2999997 ? " (ok)" : " (WRONG)");
+
+  auto a = async<int>([] { return 20; });
+  auto b = async<int>([] { return 22; });
+  auto c = async<int>([a, b] () mutable { return a.get() + b.get(); }, {a.j, b.j});
+  println(hlog, "jobs: dependent futures ", c.get(), c.get() == 42 ? " (ok)" : " (WRONG)");
+
+  #if CAP_THREAD
+  std::mutex ids_lock;
+  set<std::thread::id> ids;
+  parallel_for(1000, [&] (int i) { std::unique_lock<std::mutex> lk(ids_lock); ids.insert(std::this_thread::get_id()); }, 2);
+  println(hlog, "jobs: parallel_for capped at 2 threads used ", isize(ids), isize(ids) <= 2 ? " (ok)" : " (WRONG)");
+  #endif
+
+  cancel_token token;
+  token.cancel();
+  int ran = 0;
+  wait(submit([&] { ran++; }, {}, &token));
+  parallel_for(1000, [&] (int i) { ran++; }, 1, &token);
+  println(hlog, "jobs: cancelled jobs ran ", ran, " times", ran == 0 ? " (ok)" : " (WRONG)");
+
+  println(hlog, "jobs: test took ", int(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count()), " ms");
+  }
+
+auto hooks = addHook(hooks_final_cleanup, 200, stop)
+  + addHook(hooks_configfile, 100, [] {
+    param_i(threads, "job_threads", 0)
+    ->editable(0, 64, 1, "worker threads", "The number of threads for parallel computations. 0 = use all the hardware threads. Takes effect after restart.", 'j');
+    })
+#if CAP_COMMANDLINE
+  + addHook(hooks_args, 100, [] {
+    using namespace arg;
+    if(0) ;
+    else if(argis("-jobs")) {
+      shift(); threads = argi(); stop();
+      }
+    else if(argis("-jobs-test")) test();
+    else return 1;
+    return 0;
+    })
+#endif
+  ;
+
+EX }
+
+}
@@ -33,6 +33,108 @@ EX void doOvergenerate() {
     setdist(pc, 7 - getDistLimit() - genrange_bonus, NULL);
   }
 
+/** \brief speculative generation of the cells the player could reach in the next moves
+ *
+ *  At the end of each turn, plan() queues the generation that afterplayermoved() would do
+ *  for every cell within `ahead` moves. The queue is worked on in idle frames (idle()), and
+ *  whatever is left is done by finish() when the next move starts, so the order of generation
+ *  never depends on the timing. The speculative work uses its own generator, forked from
+ *  hrngen once per turn, so the game mechanics see the same hrngen stream no matter how much
+ *  was done in idle frames. With rng_streams, setdist draws from the streams of the cells instead.
+ */
+EX namespace speculative {
+  EX bool on = false;
+  EX int ahead = 1;
+  /** per-frame time budget, in microseconds */
+  EX int budget_us = 2000;
+
+  /** time spent in idle frames / when the next move started, in microseconds */
+  EX long long idle_us, finish_us;
+  EX int jobs_idle, jobs_finished;
+
+  vector<cell*> queue;
+  int qpos;
+  hr_rng fork;
+  bool working;
+
+  EX bool available() {
+    if(!on || shmup::on || racing::on || multi::players > 1) return false;
+    #if CAP_DAILY
+    if(daily::on) return false;
+    #endif
+    return WDIM == 2 && !fake::in() && !embedded_plane;
+    }
+
+  EX void plan() {
+    queue.clear(); qpos = 0;
+    if(!available()) return;
+    fork.seed(hrngen());
+    dynamicval<hr_rng> r(hrngen, fork);
+    celllister cl(cwt.at, ahead, 100000, nullptr);
+    for(cell *c: cl.lst) if(c != cwt.at) queue.push_back(c);
+    fork = hrngen;
+    }
+
+  void run(bool finishing, long long budget) {
+    if(working || qpos >= isize(queue)) return;
+    dynamicval<bool> w(working, true);
+    auto t0 = std::chrono::steady_clock::now();
+    auto elapsed = [&] { return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count(); };
+    int d = 7 - getDistLimit() - genrange_bonus;
+    dynamicval<hr_rng> r(hrngen, fork);
+    while(qpos < isize(queue) && !buggyGeneration) {
+      setdist(queue[qpos++], d, NULL);
+      (finishing ? jobs_finished : jobs_idle)++;
+      if(!finishing && elapsed() >= budget) break;
+      }
+    fork = hrngen;
+    (finishing ? finish_us : idle_us) += elapsed();
+    }
+
+  /** work on the queue for at most budget_us, but no longer than the given number of milliseconds */
+  EX void idle(int ms) { run(false, min<long long>(budget_us, ms * 1000LL)); }
+
+  /** complete the queue; called before anything in the next move may use hrngen */
+  EX void finish() { run(true, 0); }
+
+  EX void reset_stats() { idle_us = finish_us = 0; jobs_idle = jobs_finished = 0; }
+
+  EX string stats() {
+    return XLAT("%1 ms in idle frames (%2 jobs), %3 ms on move (%4 jobs)",
+      its(int(idle_us / 1000)), its(jobs_idle), its(int(finish_us / 1000)), its(jobs_finished));
+    }
+
+  auto hooks = addHook(hooks_clearmemory, 0, [] { queue.clear(); qpos = 0; reset_stats(); })
+    + addHook(hooks_removecells, 0, [] {
+      queue.erase(queue.begin(), queue.begin() + qpos); qpos = 0;
+      eliminate_if(queue, is_cell_removed);
+      })
+    + addHook(hooks_configfile, 100, [] {
+      param_b(on, "speculative_generation", false)
+      ->editable("speculative generation", 'g')
+      ->help("Generate the cells which the next moves could reach during idle frames, to avoid stalls when moving fast. Not used in the daily challenge, shmup, racing and multiplayer.");
+      param_i(ahead, "speculative_ahead", 1)
+      ->editable(1, 3, 1, "speculative generation: moves ahead", "", 'h');
+      param_i(budget_us, "speculative_budget", 2000)
+      ->editable(100, 20000, 500, "speculative generation: budget per frame (µs)", "", 'b');
+      })
+    #if CAP_COMMANDLINE
+    + addHook(hooks_args, 100, [] {
+      using namespace arg;
+      if(0) ;
+      else if(argis("-specgen")) {
+        shift(); ahead = argi(); on = ahead > 0;
+        }
+      else if(argis("-specgen-budget")) {
+        shift(); budget_us = argi();
+        }
+      else return 1;
+      return 0;
+      })
+    #endif
+    ;
+  EX }
+
 EX bool notDippingFor(eItem i) {
   if(peace::on) return false;
   if(ls::chaoticity() >= 60) return true;
@@ -3003,6 +3105,7 @@ EX void set_land_for_geometry(cell *c) {
 EX hookset<bool(cell *c, int d, cell *from)> hooks_cellgen;
 
 EX void setdist(cell *c, int d, cell *from) {
+  PROFILE("setdist");
 
   if(c == &out_of_bounds) return;
   if(fake::in()) return FPIU(setdist(c, d, from));
@@ -3012,6 +3115,7 @@ EX void setdist(cell *c, int d, cell *from) {
   if(c->mpdist <= d) return;
   if(c->mpdist > d+1 && d < BARLEV) setdist(c, d+1, from);
   c->mpdist = d;
+  rng_scope rs("setdist", c, d + 64);
   
   // this fixes the following problem:
   // http://steamcommunity.com/app/342610/discussions/0/1470840994970724215/
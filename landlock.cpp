@@ -222,8 +222,8 @@ EX bool landUnlockedRPM(eLand n) {
 
 EX int lands_for_hell() {
   // Archipelago: Overwrite lands needed for hell with slot data from host.
-  if (ap::apIsEnabled()) {
-    return ap::getLandsForHell();
+  if (apq::enabled()) {
+    return apq::lands_for_hell();
   }
   return casual ? 40 : 9;
   }
@@ -241,8 +241,8 @@ EX bool landAccessibleFromIngame(eLand l) {
   
 
 
-  if (ap::apIsEnabled()) {
-    if (!ap::landUnlocked(l)) {
+  if (apq::enabled()) {
+    if (!apq::land_unlocked(l)) {
       return false;
     }
   }
@@ -269,7 +269,7 @@ EX bool landAccessibleFromIngame(eLand l) {
     #define ACCONLY4(a,b,c,d) if(!isLandIngame(a) && !isLandIngame(b) && !isLandIngame(c) && !isLandIngame(d)) return false;
     #define ACCONLY5(a,b,c,d,e) if(!isLandIngame(a) && !isLandIngame(b) && !isLandIngame(c) && !isLandIngame(d) && !isLandIngame(e)) return false;
     #define ACCONLYF(x) if(!isLandIngame(x)) return false;
-    #define IFINGAME(land, ok, fallback) if(isLandIngame(land) || ap::apIsEnabled()) { ok } else { fallback }
+    #define IFINGAME(land, ok, fallback) if(isLandIngame(land) || apq::enabled()) { ok } else { fallback }
     #define INMODE(x) ;
     #include "content.cpp"
 
@@ -317,7 +317,7 @@ EX bool landUnlocked(eLand l) {
     #define ACCONLY4(a,b,c,d)
     #define ACCONLY5(a,b,c,d,e)
     #define ACCONLYF(x)
-    #define IFINGAME(land, ok, fallback) if(isLandIngame(land) || ap::apIsEnabled()) { ok } else { fallback }
+    #define IFINGAME(land, ok, fallback) if(isLandIngame(land) || apq::enabled()) { ok } else { fallback }
     #define INMODE(x) if(x) return true;
     #include "content.cpp"
 
@@ -1371,8 +1371,8 @@ EX namespace mapeditor {
     return XLAT(mapeditorhelp) + XLAT(patthelp);
     }
 
-  struct undo_info {
-    cell *c;
+  /** the part of the cell state which undo/redo restores */
+  struct undo_state {
     eWall w;
     eItem i;
     eMonster m;
@@ -1381,47 +1381,134 @@ EX namespace mapeditor {
     int32_t lparam;
     char dir;
     };
-  
-  vector<undo_info> undo;
-  
-  bool checkEq(undo_info& u) {
-    return u.w == u.c->wall && u.i == u.c->item && u.m == u.c->monst && u.l == u.c->land &&
-      u.dir == u.c->mondir && u.lparam == u.c->landparam && u.wparam == u.c->wparam;
+
+  enum { uWall = 1, uItem = 2, uMonst = 4, uLand = 8, uWparam = 16, uLparam = 32, uDir = 64 };
+
+  /** consecutive edits which changed the same fields from the same values to the same values */
+  struct undo_run {
+    int mask;
+    undo_state before, after;
+    int qty;
+    };
+
+  /** everything changed by a single mouse press (from one undoLock() to the next) */
+  struct undo_transaction {
+    vector<cell*> cells;
+    vector<undo_run> runs;
+    size_t memory() const { return sizeof(undo_transaction) + cells.capacity() * sizeof(cell*) + runs.capacity() * sizeof(undo_run); }
+    };
+
+  /** undo memory limit, in kilobytes; the oldest transactions are forgotten first */
+  EX int undo_memory_limit = 65536;
+
+  vector<undo_transaction> undo, redo;
+  size_t undo_memory;
+  bool undo_new_group = true;
+
+  cell *undo_cell;
+  undo_state undo_before;
+
+  undo_state get_undo_state(cell *c) {
+    undo_state u;
+    u.w = c->wall; u.i = c->item; u.m = c->monst; u.l = c->land; u.dir = c->mondir;
+    u.wparam = c->wparam; u.lparam = c->landparam;
+    return u;
     }
-  
+
+  int undo_diff(const undo_state& a, const undo_state& b) {
+    return (a.w != b.w ? uWall : 0) | (a.i != b.i ? uItem : 0) | (a.m != b.m ? uMonst : 0) | (a.l != b.l ? uLand : 0) |
+      (a.wparam != b.wparam ? uWparam : 0) | (a.lparam != b.lparam ? uLparam : 0) | (a.dir != b.dir ? uDir : 0);
+    }
+
+  void set_undo_state(cell *c, const undo_state& u, int mask) {
+    if(mask & uWall) c->wall = u.w;
+    if(mask & uItem) c->item = u.i;
+    if(mask & uMonst) c->monst = u.m;
+    if(mask & uLand) c->land = u.l;
+    if(mask & uWparam) c->wparam = u.wparam;
+    if(mask & uLparam) c->landparam = u.lparam;
+    if(mask & uDir) c->mondir = u.dir;
+    }
+
   void saveUndo(cell *c) {
-    undo_info u;
-    u.c=c; u.w = c->wall; u.i = c->item; u.m = c->monst; u.l = c->land; u.dir = c->mondir;
-    u.wparam = c->wparam; u.lparam = c->landparam;
-    undo.push_back(u);
+    undo_cell = c;
+    undo_before = get_undo_state(c);
     }
 
-  undo_info& lastUndo() { return undo[isize(undo)-1]; }
-  
   void undoLock() {
-    if(!isize(undo) || lastUndo().c) {
-      undo_info i; i.c = NULL; undo.push_back(i);
-      }
+    undo_new_group = true;
+    }
+
+  void limitUndo() {
+    size_t limit = size_t(undo_memory_limit) << 10;
+    int drop = 0;
+    while(undo_memory > limit && drop < isize(undo) - 1) undo_memory -= undo[drop++].memory();
+    if(drop) undo.erase(undo.begin(), undo.begin() + drop);
+    }
+
+  /** record the change made to undo_cell since saveUndo(), if any */
+  void checkUndo() {
+    auto after = get_undo_state(undo_cell);
+    int mask = undo_diff(undo_before, after);
+    if(!mask) return;
+    redo.clear();
+    if(undo_new_group || undo.empty()) undo.emplace_back(), undo_new_group = false;
+    auto& t = undo.back();
+    undo_memory -= t.memory();
+    t.cells.push_back(undo_cell);
+    auto& r = t.runs;
+    if(r.empty() || r.back().mask != mask || undo_diff(r.back().before, undo_before) & mask || undo_diff(r.back().after, after) & mask)
+      r.push_back(undo_run{mask, undo_before, after, 1});
+    else
+      r.back().qty++;
+    undo_memory += t.memory();
+    limitUndo();
     }
 
   void applyUndo() {
-    while(isize(undo) && !lastUndo().c) undo.pop_back();
-    while(isize(undo)) {
-      undo_info& i(lastUndo());
-      if(!i.c) break;
-      i.c->wall = i.w;
-      i.c->item = i.i;
-      i.c->monst = i.m;
-      i.c->land = i.l;
-      i.c->mondir = i.dir;
-      i.c->wparam = i.wparam; 
-      i.c->landparam = i.lparam;
-      undo.pop_back();
+    if(undo.empty()) return;
+    auto& t = undo.back();
+    int ci = isize(t.cells);
+    for(int i=isize(t.runs)-1; i>=0; i--) {
+      auto& r = t.runs[i];
+      for(int k=0; k<r.qty; k++) set_undo_state(t.cells[--ci], r.before, r.mask);
       }
+    undo_memory -= t.memory();
+    redo.push_back(std::move(t));
+    undo.pop_back();
+    undo_new_group = true;
     }
-  
-  void checkUndo() {
-    if(checkEq(undo[isize(undo)-1])) undo.pop_back();
+
+  void applyRedo() {
+    if(redo.empty()) return;
+    auto& t = redo.back();
+    int ci = 0;
+    for(auto& r: t.runs)
+      for(int k=0; k<r.qty; k++) set_undo_state(t.cells[ci++], r.after, r.mask);
+    undo_memory += t.memory();
+    undo.push_back(std::move(t));
+    redo.pop_back();
+    undo_new_group = true;
+    limitUndo();
+    }
+
+  void clearUndo() {
+    undo.clear(); redo.clear(); undo_memory = 0; undo_new_group = true;
+    }
+
+  /** forget the removed cells, keeping the runs consistent */
+  void removeUndoCells(vector<undo_transaction>& v) {
+    for(auto& t: v) {
+      int ci = 0, co = 0;
+      for(auto& r: t.runs) {
+        int q = 0;
+        for(int k=0; k<r.qty; k++, ci++) if(!is_cell_removed(t.cells[ci])) t.cells[co++] = t.cells[ci], q++;
+        r.qty = q;
+        }
+      t.cells.resize(co);
+      eliminate_if(t.runs, [] (const undo_run& r) { return r.qty == 0; });
+      }
+    eliminate_if(v, [] (const undo_transaction& t) { return t.cells.empty(); });
     }
   
   int itc(int k) {
@@ -1507,6 +1594,10 @@ EX namespace mapeditor {
 
     dialog::addItem(XLAT("undo"), 'u');
     dialog::add_action(applyUndo);
+    if(!redo.empty()) {
+      dialog::addItem(XLAT("redo"), 'U');
+      dialog::add_action(applyRedo);
+      }
     if(WDIM == 3)
       dialog::addBoolItem_action(XLAT("build on walls"), building_mode, 'B');
     else dialog::addBreak(100);
@@ -3082,7 +3173,7 @@ EX namespace mapeditor {
       mapeditor::painttype = 0, mapeditor::paintwhat = 0,
       mapeditor::paintwhat_str = "clear monster";
     mapeditor::copysource.at = NULL;
-    mapeditor::undo.clear();
+    mapeditor::clearUndo();
     if(!cheater) patterns::displaycodes = false;
     if(!cheater) patterns::whichShape = 0;
     modelcell.clear();
@@ -3093,6 +3184,9 @@ EX namespace mapeditor {
   addHook(hooks_removecells, 0, [] () {
     modelcell.clear();
     set_if_removed(mapeditor::copysource.at, NULL);
+    removeUndoCells(undo); removeUndoCells(redo);
+    undo_memory = 0;
+    for(auto& t: undo) undo_memory += t.memory();
     });
 #endif
 
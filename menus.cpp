@@ -1025,7 +1025,7 @@ EX void showStartMenu() {
     dialog::handleNavigation(sym, uni);
     if (uni == 'a') {
       popScreenAll();
-      pushScreen(ap::showArchipelagoMenu);
+      pushScreen(apq::show_menu);
     }
     if(uni == 'o') uni = 'i';
 #if CAP_STARTANIM
@@ -1013,8 +1013,46 @@ EX namespace patterns {
     applyAlt(si, sub, PAT_COLORING);
     }
   
+  /** cached results of getpatterninfo, at most pattern_cache_slots (pattern, flags) pairs per cell */
+  struct pattern_cache_entry { int pat, sub, map_version; patterninfo si; };
+  std::unordered_map<cell*, vector<pattern_cache_entry>> pattern_cache;
+  constexpr int pattern_cache_slots = 4;
+  bool pattern_cache_computing;
+
+  EX bool use_pattern_cache = true;
+
+  /** the values of PAT_DOWN depend on the lands; the others depend only on the neighborhood, which must be complete,
+   *  except around the warped cells (see val_nopattern), and on lands which are not assigned yet;
+   *  the Orb of the Triangle and the warped canvas can make any cell warped */
+  bool pattern_cacheable(cell *c, ePattern pat) {
+    if(!use_pattern_cache || pattern_cache_computing || pat == PAT_DOWN) return false;
+    if(items[itOrb37] || canvasfloor == caflWarp) return false;
+    if(c->land == laNone || isWarped(c)) return false;
+    for(int i=0; i<c->type; i++) {
+      cell *c1 = c->move(i);
+      if(!c1 || c1->land == laNone || isWarped(c1)) return false;
+      }
+    return true;
+    }
+
+  EX void clear_pattern_cache() { pattern_cache.clear(); }
+
   EX patterninfo getpatterninfo(cell *c, ePattern pat, int sub) {
     if(fake::in()) return FPIU(getpatterninfo(c, pat, sub));
+    if(pattern_cacheable(c, pat)) {
+      auto& v = pattern_cache[c];
+      for(auto& e: v) if(e.pat == pat && e.sub == sub && e.map_version == mapeditor::map_version) return e.si;
+      /* entries from before a map edit are stale */
+      for(int i=0; i<isize(v); i++) if(v[i].map_version != mapeditor::map_version) v.erase(v.begin() + i), i--;
+      patterninfo si;
+      if(1) {
+        dynamicval<bool> b(pattern_cache_computing, true);
+        si = getpatterninfo(c, pat, sub);
+        }
+      if(isize(v) == pattern_cache_slots) v.erase(v.begin());
+      v.push_back(pattern_cache_entry{pat, sub, mapeditor::map_version, si});
+      return si;
+      }
     if(!(sub & SPF_NO_SUBCODES)) {
       auto si = getpatterninfo(c, pat, sub | SPF_NO_SUBCODES);
       if(1) ;
@@ -1240,6 +1278,12 @@ EX namespace patterns {
     return getpatterninfo(c, whichPattern, subpattern_flags);
     }
   #endif
+
+  /** fill the pattern cache for the cells drawn in the last frame, so that the overlay only reads cached values */
+  auto pattern_cache_hook = addHook(hooks_drawmap, 100, [] {
+    if(!displaycodes || !use_pattern_cache || gmatrix.empty()) return;
+    for(auto& p: gmatrix) getpatterninfo0(p.first);
+    });
   
   EX }
 
@@ -1540,6 +1584,15 @@ EX namespace ccolor {
 
   EX hookset<int(cell*)> hooks_generate_canvas;
 
+  /** live canvas recolors every drawn cell; resolve the cdata of the cells drawn in the last frame in a single pass */
+  auto live_canvas_hook = addHook(hooks_drawmap, 100, [] {
+    if(!live_canvas || specialland != laCanvas || gmatrix.empty()) return;
+    vector<cell*> cells;
+    cells.reserve(gmatrix.size());
+    for(auto& p: gmatrix) cells.push_back(p.first);
+    cache_cdata(cells);
+    });
+
   EX int generateCanvas(cell *c) {
     int i = callhandlers(-1, hooks_generate_canvas, c);
     if(i != -1) return i;
@@ -1922,9 +1975,10 @@ EX namespace ccolor {
 EX }
 
 EX color_t random_landscape(cell *c, int mul, int div, int step, color_t base) {
+  auto cd = getCdataAll(c);
   int col[4];
   for(int j=0; j<4; j++) {
-    col[j] = getCdata(c, j);
+    col[j] = cd[j];
     col[j] *= mul;
     col[j] %= 240;
     if(col[j] > 120) col[j] = 240 - col[j];
@@ -1935,7 +1989,7 @@ EX color_t random_landscape(cell *c, int mul, int div, int step, color_t base) {
   col[2] /= div;
   if(ISWEB) for(int a=0; a<3; a++) col[a] = (col[a] + step/2) / step * step;
   color_t res = base + col[0] + (col[1] << 8) + (col[2] << 16);
-  if(WDIM == 3 && (getBits(c) & 1)) res |= 0x1000000;
+  if(WDIM == 3 && (cd[4] & 1)) res |= 0x1000000;
   return res;
   }
 
@@ -1951,10 +2005,11 @@ EX namespace patterns {
     return gmod(p.first - p.second * 2, 7);
     }
 
-  map<cell*, color_t> computed_nearer_map;
+  std::unordered_map<cell*, color_t> computed_nearer_map;
   
   EX color_t nearer_map(cell *c) {
-    if(computed_nearer_map.count(c)) return computed_nearer_map[c];
+    auto it = computed_nearer_map.find(c);
+    if(it != computed_nearer_map.end()) return it->second;
     if(!closed_manifold) return 0;
 
     cell *sc = currentmap->gamestart();
@@ -3267,7 +3322,11 @@ int read_pattern_args() {
   return 0;
   }
 
-auto ah_pattern = addHook(hooks_args, 0, read_pattern_args) + addHook(hooks_clearmemory, 100, [] { patterns::computed_nearer_map.clear(); patterns::computed_furthest_map.clear(); });
+auto ah_pattern = addHook(hooks_args, 0, read_pattern_args) + addHook(hooks_clearmemory, 100, [] { patterns::computed_nearer_map.clear(); patterns::computed_furthest_map.clear(); patterns::clear_pattern_cache(); })
+  + addHook(hooks_removecells, 100, [] {
+    auto& pc = patterns::pattern_cache;
+    for(auto it = pc.begin(); it != pc.end();) if(is_cell_removed(it->first)) it = pc.erase(it); else ++it;
+    });
 #endif
 
 }
@@ -540,6 +540,7 @@ EX void copy_metadata(cell *x, const gcell *y) {
 #if HDR
 
 extern void playSound(cell *c, const string& fname, int vol);
+namespace speculative { void finish(); }
 
 /** \brief A structure to keep track of changes made during the player movement.
  *
@@ -547,11 +548,36 @@ extern void playSound(cell *c, const string& fname, int vol);
  */
 
 struct changes_t {
-  vector<reaction_t> rollbacks;
+  /** \brief One entry of the undo journal. */
+  struct undo_entry {
+    enum kind_t : unsigned char { ueCell, ueBytes, ueAction, ueCall } kind;
+    int size;
+    /** index into saved_cells, undo_data or actions */
+    int pos;
+    union { void *where; void (*fn)(); };
+    };
+
+  /** \brief The undo journal, undone in the reverse order. The buffers are reused, so a check allocates nothing once they have grown. */
+  vector<undo_entry> journal;
+  /** \brief the bytes of the values saved with value_keep */
+  vector<char> undo_data;
+  vector<pair<cell*, gcell>> saved_cells;
+  /** \brief rollbacks of values which cannot be copied bytewise, and at_rollback actions */
+  vector<reaction_t> actions;
   vector<reaction_t> commits;
   bool on;
   bool checking;
-  
+
+  /** \brief kills, items, orbused and hrngen as of the last init() outside of a change; only the slots which differ are copied */
+  array<int, motypes> kills_shadow;
+  array<int, ittypes> items_shadow;
+  array<bool, ittypes> orbused_shadow;
+  hr_rng rng_shadow;
+
+  template<class T, size_t N> static void copy_dirty(const array<T, N>& from, array<T, N>& to) {
+    for(size_t i=0; i<N; i++) if(to[i] != from[i]) to[i] = from[i];
+    }
+
   /**
    * \brief Start keeping track of changes, perform changes.
    *
@@ -561,50 +587,82 @@ struct changes_t {
    */
    
   void init(bool ch) {
+    speculative::finish();
+    if(!on) {
+      copy_dirty(kills, kills_shadow);
+      copy_dirty(items, items_shadow);
+      copy_dirty(orbused, orbused_shadow);
+      /* in checkmove() the generator is the same for every check, so it is copied only once */
+      if(!(hrngen == rng_shadow)) rng_shadow = hrngen;
+      }
     on = true; 
     ccell(cwt.at);
     forCellEx(c1, cwt.at) ccell(c1);
-    value_keep(kills);
-    value_keep(items);
-    value_keep(orbused);
-    value_keep(hrngen);
     checking = ch;
     }
 
+  void clear() {
+    journal.clear();
+    undo_data.clear();
+    saved_cells.clear();
+    actions.clear();
+    commits.clear();
+    }
+
   /** \brief Commit the changes. Should only be called after init(false). */
 
   void commit() { 
     on = false; 
     for(auto& p: commits) p();
-    rollbacks.clear();
-    commits.clear();
+    clear();
     }
 
   /** \brief Rollback the changes. */
 
-  void rollback(int pos = 0) { 
+  void rollback() { 
+    if(!on) { clear(); return; }
     on = false;
-    while(!rollbacks.empty()) {
-      rollbacks.back()();
-      rollbacks.pop_back();
+    undo_since(0);
+    copy_dirty(kills_shadow, kills);
+    copy_dirty(items_shadow, items);
+    copy_dirty(orbused_shadow, orbused);
+    if(!(hrngen == rng_shadow)) hrngen = rng_shadow;
+    clear();
+    }
+
+  void undo_since(int pos) {
+    for(int i=isize(journal)-1; i>=pos; i--) {
+      auto& e = journal[i];
+      switch(e.kind) {
+        case undo_entry::ueCell: copy_metadata(saved_cells[e.pos].first, &saved_cells[e.pos].second); break;
+        case undo_entry::ueBytes: memcpy(e.where, &undo_data[e.pos], e.size); break;
+        case undo_entry::ueAction: actions[e.pos](); break;
+        case undo_entry::ueCall: e.fn(); break;
+        }
       }
-    rollbacks.clear();
-    commits.clear();
+    journal.resize(pos);
     }
-  
+
+  /** \brief The current position in the journal. */
+  int mark() { return isize(journal); }
+
+  /** \brief Forget the changes recorded after mark() returned pos; they will not be rolled back. */
+  void discard_since(int pos) { journal.resize(pos); }
+
   /** \brief The changes to cell c will be rolled back when rollback() is called. */
   void ccell(cell *c) {
     if(!on) return;
-    gcell a = *c;
-    rollbacks.push_back([c, a] { copy_metadata(c, &a); });
+    undo_entry e;
+    e.kind = undo_entry::ueCell; e.size = 0; e.pos = isize(saved_cells); e.where = c;
+    saved_cells.emplace_back(c, *c);
+    journal.push_back(e);
     }
   
   /** \brief Set the value of what to value. This change will be rolled back if necessary. */
   template<class T> void value_set(T& what, T value) {
     if(!on) { what = value; return; }
     if(what == value) return;
-    T old = what;
-    rollbacks.push_back([&what, old] { what = old; });
+    value_keep(what);
     what = value;
     }
 
@@ -620,8 +678,20 @@ struct changes_t {
 
   template<class T> void value_keep(T& what) {
     if(!on) return;
+    keep(what, std::integral_constant<bool, std::is_trivially_copyable<T>::value>());
+    }
+
+  template<class T> void keep(T& what, std::true_type) {
+    undo_entry e;
+    e.kind = undo_entry::ueBytes; e.size = sizeof(T); e.pos = isize(undo_data); e.where = (void*) &what;
+    undo_data.resize(e.pos + sizeof(T));
+    memcpy(&undo_data[e.pos], (void*) &what, sizeof(T));
+    journal.push_back(e);
+    }
+
+  template<class T> void keep(T& what, std::false_type) {
     T old = what;
-    rollbacks.push_back([&what, old] { what = old; });
+    at_rollback([&what, old] { what = old; });
     }
   
   /** \brief Like value_keep but for maps. */
@@ -646,13 +716,19 @@ struct changes_t {
   /** \brief Perform the given action on rollback. */
 
   void at_rollback(reaction_t act) {
-    if(on) rollbacks.emplace_back(act);
+    if(!on) return;
+    undo_entry e;
+    e.kind = undo_entry::ueAction; e.size = 0; e.pos = isize(actions); e.where = nullptr;
+    actions.emplace_back(act);
+    journal.push_back(e);
     }
 
   void push_push(cell *tgt) {
     pushes.push_back(tgt);
-    auto v = [] { pushes.pop_back(); };
-    rollbacks.push_back(v);
+    void (*v)() = [] { pushes.pop_back(); };
+    undo_entry e;
+    e.kind = undo_entry::ueCall; e.size = 0; e.pos = 0; e.fn = v;
+    journal.push_back(e);
     commits.push_back(v);
     }
   };
@@ -0,0 +1,214 @@
+// Hyperbolic Rogue -- profiling timers
+// Copyright (C) 2011-2019 Zeno Rogue, see 'hyper.cpp' for details
+
+/** \file profiler.cpp
+ *  \brief scoped timers for the main subsystems, with an overlay and a Chrome trace dump
+ *
+ *  PROFILE("name") times the rest of the enclosing scope. Completed timings go to a ring
+ *  buffer owned by the thread, so recording takes no lock. When compiled with
+ *  CAP_PROFILING=0 (the default), PROFILE expands to nothing. When compiled in but not
+ *  turned on, a timer costs one test of profiler::on.
+ */
+
+#include "hyper.h"
+namespace hr {
+
+#if HDR
+#if CAP_PROFILING && CAP_THREAD
+namespace profiler { extern bool on; int zone_id(const char *name); long long now_ns(); void record(int zone, long long t0); }
+
+/** times the enclosing scope */
+struct profile_scope {
+  int zone;
+  long long t0;
+  profile_scope(int z) : zone(z), t0(profiler::on ? profiler::now_ns() : 0) {}
+  ~profile_scope() { if(t0) profiler::record(zone, t0); }
+  };
+#define PROFILE_CAT1(a, b) a ## b
+#define PROFILE_CAT(a, b) PROFILE_CAT1(a, b)
+#define PROFILE(name) static const int PROFILE_CAT(profile_zone_, __LINE__) = profiler::zone_id(name); profile_scope PROFILE_CAT(profile_scope_, __LINE__)(PROFILE_CAT(profile_zone_, __LINE__))
+#else
+#define PROFILE(name)
+#endif
+#endif
+
+#if CAP_PROFILING && CAP_THREAD
+
+EX namespace profiler {
+
+/** are the timers recording */
+EX bool on = false;
+
+/** show the per-frame times on the screen */
+EX bool overlay = false;
+
+/** the Chrome trace is written here on exit; empty for none */
+EX string trace_file = "";
+
+struct sample { int zone, tid; long long t0, t1; };
+
+static constexpr int ring_size = 1 << 14;
+
+struct ring {
+  int tid;
+  std::atomic<unsigned> written;
+  sample buf[ring_size];
+  };
+
+/** guards the zone names and the list of rings */
+std::mutex lock;
+vector<string> zones;
+vector<std::unique_ptr<ring>> rings;
+vector<ring*> free_rings;
+int next_tid;
+
+/** threads come and go (many workers live for one frame), so their rings are reused */
+struct ring_holder {
+  ring *r = nullptr;
+  ring *get() {
+    if(r) return r;
+    std::unique_lock<std::mutex> lk(lock);
+    if(free_rings.empty()) {
+      rings.emplace_back(new ring);
+      rings.back()->written = 0;
+      free_rings.push_back(rings.back().get());
+      }
+    r = free_rings.back(); free_rings.pop_back();
+    r->tid = next_tid++;
+    return r;
+    }
+  ~ring_holder() {
+    if(!r) return;
+    std::unique_lock<std::mutex> lk(lock);
+    free_rings.push_back(r);
+    }
+  };
+
+thread_local ring_holder my_ring;
+
+EX int zone_id(const char *name) {
+  std::unique_lock<std::mutex> lk(lock);
+  for(int i=0; i<isize(zones); i++) if(zones[i] == name) return i;
+  zones.push_back(name);
+  return isize(zones) - 1;
+  }
+
+static const auto epoch = std::chrono::steady_clock::now();
+
+/** nanoseconds since the start; never 0, which profile_scope uses for 'not timed' */
+EX long long now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count() + 1;
+  }
+
+EX void record(int zone, long long t0) {
+  ring *r = my_ring.get();
+  unsigned w = r->written.load(std::memory_order_relaxed);
+  /* a reader which sees this sample being written also sees that written has reached w */
+  std::atomic_thread_fence(std::memory_order_release);
+  r->buf[w % ring_size] = sample{zone, r->tid, t0, now_ns()};
+  r->written.store(w+1, std::memory_order_release);
+  }
+
+/** call f on every sample still in the buffers which ended after `since`;
+ *  the other threads keep recording, so every sample is copied and dropped if its slot has been reused meanwhile */
+template<class T> void for_samples(long long since, const T& f) {
+  std::unique_lock<std::mutex> lk(lock);
+  for(auto& r: rings) {
+    unsigned w = r->written.load(std::memory_order_acquire);
+    unsigned first = w > ring_size ? w - ring_size : 0;
+    for(unsigned i=w; i>first; i--) {
+      sample s = r->buf[(i-1) % ring_size];
+      std::atomic_thread_fence(std::memory_order_acquire);
+      /* slot i-1 is rewritten once the writer reaches i-1+ring_size; the older samples are gone too */
+      if(r->written.load(std::memory_order_relaxed) - (i-1) >= unsigned(ring_size)) break;
+      if(s.t1 <= since) break;
+      f(s);
+      }
+    }
+  }
+
+/** per-zone times for the overlay */
+struct zone_stats { double last_ms, avg_ms; int calls; };
+vector<zone_stats> stats;
+long long last_frame;
+
+void update_stats() {
+  long long now = now_ns();
+  vector<double> frame_ms(isize(zones), 0);
+  vector<int> frame_calls(isize(zones), 0);
+  for_samples(last_frame, [&] (const sample& s) {
+    if(s.zone >= isize(frame_ms)) return;
+    frame_ms[s.zone] += (s.t1 - s.t0) / 1e6;
+    frame_calls[s.zone]++;
+    });
+  last_frame = now;
+  if(isize(stats) < isize(frame_ms)) stats.resize(isize(frame_ms), zone_stats{0, 0, 0});
+  for(int i=0; i<isize(frame_ms); i++) if(frame_calls[i]) {
+    auto& st = stats[i];
+    st.last_ms = frame_ms[i];
+    st.avg_ms = st.calls ? st.avg_ms * .9 + frame_ms[i] * .1 : frame_ms[i];
+    st.calls += frame_calls[i];
+    }
+  }
+
+void draw_overlay() {
+  if(!on) return;
+  update_stats();
+  if(!overlay) return;
+  int y = vid.fsize * 3;
+  displaystr(vid.fsize, y, 0, vid.fsize, XLAT("zone: last / average ms (calls)"), 0xC0C0C0, 0);
+  for(int i=0; i<isize(stats); i++) if(stats[i].calls) {
+    y += vid.fsize;
+    displaystr(vid.fsize, y, 0, vid.fsize, zones[i] + ": " + fts(stats[i].last_ms, 3) + " / " + fts(stats[i].avg_ms, 3) + " (" + its(stats[i].calls) + ")", 0xFFFFFF, 0);
+    }
+  }
+
+/** write everything still in the buffers in the Chrome trace event format (chrome://tracing, Perfetto) */
+EX void dump_trace(const string& fname) {
+  FILE *f = fopen(fname.c_str(), "wt");
+  if(!f) { println(hlog, "failed to open ", fname); return; }
+  fprintf(f, "{\"traceEvents\":[\n");
+  bool first = true;
+  int qty = 0;
+  vector<sample> all;
+  for_samples(0, [&] (const sample& s) { all.push_back(s); });
+  sort(all.begin(), all.end(), [] (const sample& a, const sample& b) { return a.t0 < b.t0; });
+  for(auto& s: all) {
+    fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", first ? "" : ",\n",
+      zones[s.zone].c_str(), s.tid, s.t0 / 1e3, (s.t1 - s.t0) / 1e3);
+    first = false;
+    qty++;
+    }
+  fprintf(f, "\n]}\n");
+  fclose(f);
+  println(hlog, "saved ", qty, " profiler events to ", fname);
+  }
+
+auto hooks = addHook(hooks_stats, 100, draw_overlay)
+  + addHook(hooks_final_cleanup, 100, [] { if(trace_file != "") dump_trace(trace_file); })
+  + addHook(hooks_configfile, 100, [] {
+    param_b(overlay, "profiler_overlay", false)
+    ->editable("profiler overlay", 'P');
+    })
+#if CAP_COMMANDLINE
+  + addHook(hooks_args, 100, [] {
+    using namespace arg;
+    if(0) ;
+    else if(argis("-profile")) on = true;
+    else if(argis("-profile-overlay")) on = overlay = true;
+    else if(argis("-profile-trace")) {
+      shift(); trace_file = args(); on = true;
+      }
+    else if(argis("-profile-dump")) {
+      shift(); dump_trace(args());
+      }
+    else return 1;
+    return 0;
+    })
+#endif
+  ;
+
+EX }
+#endif
+
+}
@@ -1337,13 +1337,17 @@ void draw_ghost_at(ghost& ghost, cell *w, const shiftmatrix& V, ghostmoment& p)
   drawMonsterType(moPlayer, w, V, 0, uchar_to_frac(p.footphase), NOCOLOR);
   }
 
+/** the first moment after the current time; the steps are increasing, so binary search is used */
+vector<ghostmoment>::iterator ghost_next_moment(ghost& ghost) {
+  return std::upper_bound(ghost.history.begin(), ghost.history.end(), ticks - race_start_tick, [] (int t, const ghostmoment& gm) { return t < gm.step; });
+  }
+
 bool ghost_finished(ghost& ghost) {
-  auto p = std::find_if(ghost.history.begin(), ghost.history.end(), [] (const ghostmoment gm) { return gm.step > ticks - race_start_tick;} );
-  return p == ghost.history.end();
+  return ghost_next_moment(ghost) == ghost.history.end();
   }
 
 ghostmoment& get_ghostmoment(ghost& ghost) {
-  auto p = std::find_if(ghost.history.begin(), ghost.history.end(), [] (const ghostmoment gm) { return gm.step > ticks - race_start_tick;} );
+  auto p = ghost_next_moment(ghost);
   if(p == ghost.history.end()) p--, p->footphase = 0;
   return *p;
   }
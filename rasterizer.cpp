@@ -0,0 +1,354 @@
+// Hyperbolic Rogue -- software rasterizer
+// Copyright (C) 2011-2019 Zeno Rogue, see 'hyper.cpp' for details
+
+/** \file rasterizer.cpp
+ *  \brief a tiled, multithreaded software rasterizer for the non-OpenGL renderer
+ *
+ *  When enabled, the polygons drawn from the draw queue in the non-OpenGL mode
+ *  are not passed to SDL_gfx one by one. Instead, they are recorded with subpixel
+ *  coordinates, binned into screen tiles, and rasterized (with antialiasing)
+ *  in parallel. This is mostly useful for rendering screenshots and animations
+ *  on machines without a GPU.
+ *
+ *  Items which are not polygons (texts, circles, textures, actions) flush the
+ *  recorded polygons before drawing, so the drawing order is not changed.
+ */
+
+#include "hyper.h"
+namespace hr {
+
+EX namespace swr {
+
+/** while true, polygons are collected and rasterized on flush(); otherwise they are rasterized immediately */
+EX bool batching = false;
+
+#if CAP_SDL
+
+/** is the software rasterizer used instead of SDL_gfx polygons */
+EX bool on = false;
+
+/** the number of sub-scanlines per pixel row; horizontal coverage is computed exactly. 1 = no antialiasing */
+EX int aa = 4;
+
+/** 0 = use all the hardware threads */
+EX int threads = 0;
+
+EX int tile_size = 64;
+
+/** batches smaller than this are rasterized without starting extra threads */
+EX int thread_threshold = 256;
+
+struct fpoint { float x, y; };
+
+struct edge {
+  float x0, y0, y1, dxdy;
+  int dir;
+  };
+
+struct shape {
+  int e0, e1;
+  color_t color;
+  bool nonzero;
+  int minx, miny, maxx, maxy;
+  };
+
+vector<edge> edges;
+vector<shape> shapes;
+
+EX bool active() {
+  return on && !vid.usingGL && s && !current_display->separate_eyes();
+  }
+
+void start_shape(color_t col, bool nonzero) {
+  shapes.emplace_back();
+  auto& sh = shapes.back();
+  sh.e0 = sh.e1 = isize(edges);
+  sh.color = col;
+  sh.nonzero = nonzero;
+  sh.minx = sh.miny = 1000000000;
+  sh.maxx = sh.maxy = -1000000000;
+  }
+
+void add_contour(const fpoint *p, int n) {
+  auto& sh = shapes.back();
+  auto pixel = [] (float v) { return (int) floor(max(-1e6f, min(1e6f, v))); };
+  for(int i=0; i<n; i++) {
+    fpoint a = p[i], b = p[(i+1) % n];
+    if(std::isnan(a.x) || std::isnan(a.y)) continue;
+    sh.minx = min(sh.minx, pixel(a.x));
+    sh.maxx = max(sh.maxx, pixel(a.x));
+    sh.miny = min(sh.miny, pixel(a.y));
+    sh.maxy = max(sh.maxy, pixel(a.y));
+    if(a.y == b.y || std::isnan(b.x) || std::isnan(b.y)) continue;
+    edge e;
+    e.dir = a.y < b.y ? 1 : -1;
+    if(a.y > b.y) swap(a, b);
+    e.x0 = a.x; e.y0 = a.y; e.y1 = b.y;
+    e.dxdy = (b.x - a.x) / (b.y - a.y);
+    edges.push_back(e);
+    }
+  sh.e1 = isize(edges);
+  }
+
+void finish_shape() {
+  auto& sh = shapes.back();
+  sh.minx = max(sh.minx, 0); sh.maxx = min(sh.maxx, s->w - 1);
+  sh.miny = max(sh.miny, 0); sh.maxy = min(sh.maxy, s->h - 1);
+  if(sh.e0 == sh.e1 || sh.minx > sh.maxx || sh.miny > sh.maxy) {
+    edges.resize(sh.e0);
+    shapes.pop_back();
+    }
+  }
+
+/** record a polygon in screen coordinates, as computed by dqi_poly::draw; linewidth is the outline width in pixels */
+EX void draw_poly(const vector<glvertex>& v, flagtype flags, color_t color, color_t outline, int linewidth) {
+  int n = isize(v);
+  if(!n) return;
+  static vector<fpoint> pts;
+  pts.resize(n);
+  float xc = current_display->xcenter, yc = current_display->ycenter;
+  for(int i=0; i<n; i++) pts[i] = fpoint{xc + v[i][0], yc + v[i][1]};
+
+  if(color & 0xFF) {
+    if(flags & POLY_TRIANGLES) {
+      for(int i=0; i+3<=n; i+=3) {
+        start_shape(color, false);
+        add_contour(&pts[i], 3);
+        finish_shape();
+        }
+      }
+    else {
+      start_shape(color, false);
+      add_contour(&pts[0], n);
+      if(flags & POLY_INVERSE) {
+        fpoint screen[4] = {{0, 0}, {float(vid.xres), 0}, {float(vid.xres), float(vid.yres)}, {0, float(vid.yres)}};
+        add_contour(screen, 4);
+        }
+      finish_shape();
+      }
+    }
+
+  if((outline & 0xFF) && n > 1) {
+    /* all the segments form one shape with the nonzero rule, so the joints are not drawn twice */
+    start_shape(outline, true);
+    float hw = linewidth / 2.;
+    for(int i=1; i<n; i++) {
+      fpoint a = pts[i-1], b = pts[i];
+      float dx = b.x - a.x, dy = b.y - a.y;
+      float len = sqrt(dx*dx + dy*dy);
+      if(len < 1e-3 || std::isnan(len)) continue;
+      dx *= hw / len; dy *= hw / len;
+      fpoint quad[4] = {
+        {a.x - dx - dy, a.y - dy + dx}, {b.x + dx - dy, b.y + dy + dx},
+        {b.x + dx + dy, b.y + dy - dx}, {a.x - dx + dy, a.y - dy - dx}
+        };
+      add_contour(quad, 4);
+      }
+    finish_shape();
+    }
+
+  if(!batching) flush();
+  }
+
+struct crossing {
+  float x;
+  int dir;
+  bool operator < (const crossing& c) const { return x < c.x; }
+  };
+
+/** per-thread buffers */
+struct tile_context {
+  vector<float> cov;
+  vector<crossing> cr;
+  };
+
+void blend(color_t& pix, color_t col, int alpha) {
+  for(int p=0; p<3; p++) {
+    int a = part(pix, p), b = part(col, p+1);
+    part(pix, p) = a + (b - a) * alpha / 255;
+    }
+  }
+
+void raster_shape(tile_context& ctx, const shape& sh, int tx0, int ty0, int tx1, int ty1) {
+  int x0 = max(tx0, sh.minx), x1 = min(tx1, sh.maxx + 1);
+  int y0 = max(ty0, sh.miny), y1 = min(ty1, sh.maxy + 1);
+  if(x0 >= x1 || y0 >= y1) return;
+
+  int S = max(aa, 1);
+  float w = 1. / S;
+  auto& cov = ctx.cov;
+  auto& cr = ctx.cr;
+  cov.resize(x1 - x0);
+
+  auto span = [&] (float l, float r) {
+    if(l < x0) l = x0;
+    if(r > x1) r = x1;
+    if(l >= r) return;
+    if(S == 1) {
+      int il = (int) ceil(l - .5), ir = (int) ceil(r - .5);
+      for(int i=il; i<ir; i++) cov[i-x0] += 1;
+      return;
+      }
+    int il = (int) floor(l), ir = (int) floor(r);
+    if(il == ir) { cov[il-x0] += (r - l) * w; return; }
+    cov[il-x0] += (il + 1 - l) * w;
+    for(int i=il+1; i<ir; i++) cov[i-x0] += w;
+    if(ir < x1) cov[ir-x0] += (r - ir) * w;
+    };
+
+  int alpha = sh.color & 0xFF;
+
+  for(int y=y0; y<y1; y++) {
+    for(auto& c: cov) c = 0;
+    bool any = false;
+    for(int sub=0; sub<S; sub++) {
+      float sy = y + (sub + .5) * w;
+      cr.clear();
+      for(int ei=sh.e0; ei<sh.e1; ei++) {
+        auto& e = edges[ei];
+        if(sy < e.y0 || sy >= e.y1) continue;
+        cr.push_back(crossing{e.x0 + (sy - e.y0) * e.dxdy, e.dir});
+        }
+      if(cr.empty()) continue;
+      any = true;
+      sort(cr.begin(), cr.end());
+      if(sh.nonzero) {
+        int wind = 0;
+        float start = 0;
+        for(auto& c: cr) {
+          if(wind == 0) start = c.x;
+          wind += c.dir;
+          if(wind == 0) span(start, c.x);
+          }
+        }
+      else {
+        for(int i=0; i+1<isize(cr); i+=2) span(cr[i].x, cr[i+1].x);
+        }
+      }
+    if(!any) continue;
+    color_t *row = (color_t*) ((char*) s->pixels + y * s->pitch);
+    for(int x=x0; x<x1; x++) {
+      float c = cov[x-x0];
+      if(c <= 0) continue;
+      if(c >= 1) c = 1;
+      int a = (int) (c * alpha + .5);
+      if(a) blend(row[x], sh.color, a);
+      }
+    }
+  }
+
+/** rasterize all the recorded polygons */
+EX void flush() {
+  if(shapes.empty()) return;
+  if(!s) { shapes.clear(); edges.clear(); return; }
+
+  int ts = max(tile_size, 8);
+  int tx = (s->w + ts - 1) / ts, ty = (s->h + ts - 1) / ts;
+  static vector<vector<int>> bins;
+  bins.resize(tx * ty);
+  for(auto& b: bins) b.clear();
+  for(int i=0; i<isize(shapes); i++) {
+    auto& sh = shapes[i];
+    for(int y=sh.miny/ts; y<=sh.maxy/ts; y++)
+    for(int x=sh.minx/ts; x<=sh.maxx/ts; x++)
+      bins[y * tx + x].push_back(i);
+    }
+
+  SDL_LockSurface(s);
+
+  auto render_tile = [&] (tile_context& ctx, int t) {
+    int x0 = (t % tx) * ts, y0 = (t / tx) * ts;
+    int x1 = min(x0 + ts, s->w), y1 = min(y0 + ts, s->h);
+    for(int i: bins[t]) raster_shape(ctx, shapes[i], x0, y0, x1, y1);
+    };
+
+  int nt = isize(shapes) < thread_threshold ? 1 : min(threads ? threads : jobs::pool_size(), jobs::pool_size());
+
+  if(nt == 1) {
+    static tile_context ctx;
+    for(int t=0; t<tx*ty; t++) if(!bins[t].empty()) render_tile(ctx, t);
+    }
+  #if CAP_THREAD
+  else {
+    std::atomic<int> next_tile(0);
+    jobs::parallel_for(nt, [&] (int) {
+      tile_context ctx;
+      while(true) {
+        int t = next_tile++;
+        if(t >= tx * ty) return;
+        if(!bins[t].empty()) render_tile(ctx, t);
+        }
+      }, nt);
+    }
+  #endif
+
+  SDL_UnlockSurface(s);
+  shapes.clear();
+  edges.clear();
+  }
+
+/** render the current view the given number of times, with SDL_gfx and with the software rasterizer, and report the speed */
+EX void benchmark(int frames) {
+  dynamicval<bool> dg(vid.usingGL, vid.usingGL);
+  resetbuffer rb;
+  renderbuffer buf(vid.xres, vid.yres, false);
+  buf.enable();
+  current_display->set_viewport(0);
+  for(int mode=0; mode<2; mode++) {
+    dynamicval<bool> don(on, mode);
+    auto t0 = std::chrono::steady_clock::now();
+    for(int i=0; i<frames; i++) {
+      buf.clear(backcolor);
+      shot::default_screenshot_content();
+      }
+    auto t1 = std::chrono::steady_clock::now();
+    double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+    println(hlog, mode ? "software rasterizer" : "SDL_gfx", ": ", vid.xres, "x", vid.yres, ", ", frames, " frames, ", ms / max(frames, 1), " ms per frame");
+    }
+  rb.reset();
+  }
+
+#if CAP_COMMANDLINE
+int read_args() {
+  using namespace arg;
+  if(0) ;
+  else if(argis("-swr")) {
+    PHASEFROM(2);
+    shift(); on = argi();
+    }
+  else if(argis("-swr-aa")) {
+    PHASEFROM(2);
+    shift(); aa = argi();
+    }
+  else if(argis("-swr-threads")) {
+    PHASEFROM(2);
+    shift(); threads = argi();
+    }
+  else if(argis("-swr-bench")) {
+    PHASEFROM(3); start_game();
+    shift(); benchmark(argi());
+    }
+  else return 1;
+  return 0;
+  }
+
+auto swr_hook = addHook(hooks_args, 100, read_args);
+#endif
+
+auto swr_config = addHook(hooks_configfile, 100, [] {
+  param_b(on, "software_rasterizer", false)
+  ->editable("software rasterizer", 'R')
+  ->help("Draw polygons with a tiled, multithreaded rasterizer instead of SDL_gfx. Only used without OpenGL, e.g., for headless screenshots.");
+  param_i(aa, "software_rasterizer_aa", 4)
+  ->editable(1, 16, 1, "software rasterizer: subsamples", "The number of sub-scanlines per pixel row. 1 disables antialiasing.", 'a');
+  param_i(threads, "software_rasterizer_threads", 0)
+  ->editable(0, 64, 1, "software rasterizer: threads", "0 = use all the hardware threads", 't');
+  });
+
+#else
+EX void flush() {}
+#endif
+
+EX }
+
+}
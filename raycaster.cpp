@@ -1943,15 +1943,20 @@ void raygen::emit_raystarter() {
     }
   }
 
+/** the number of slots reserved for each cell in the raycaster tables */
+int sample_degree() {
+  int deg = 0;
+  auto samples = used_sample_list();
+  for(int i=0; i<isize(samples)-1; i++)
+    deg = max(deg, samples[i+1].first - samples[i].first);
+  return deg;
+  }
+
 void raygen::create() {
   using glhr::to_glsl;
   currentmap->wall_offset(centerover); /* so raywall is not empty and deg is not zero */
 
-  deg = 0;
-
-  auto samples = used_sample_list();
-  for(int i=0; i<isize(samples)-1; i++)
-    deg = max(deg, samples[i+1].first - samples[i].first);
+  deg = sample_degree();
 
   if(true) {
     asonov = hr::asonov::in();
@@ -2281,6 +2286,22 @@ void bind_array(vector<array<float, 4>>& v, GLint t, GLuint& tx, int id, int len
   GLERR("bind_array");
   }
 
+/** upload only the given rows of an array previously bound with bind_array */
+void update_array_rows(vector<array<float, 4>>& v, GLint t, GLuint& tx, int id, int length, const set<int>& rows) {
+  if(rows.empty()) return;
+  glUniform1i(t, id);
+  glActiveTexture(GL_TEXTURE0 + id);
+  glBindTexture(GL_TEXTURE_2D, tx);
+  GLERR("bindTexture");
+  auto it = rows.begin();
+  while(it != rows.end()) {
+    int r0 = *it, r1 = r0 + 1;
+    for(++it; it != rows.end() && *it == r1; ++it) r1++;
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, r0, length, r1 - r0, GL_RGBA, GL_FLOAT, &v[r0 * length]);
+    }
+  GLERR("update_array_rows");
+  }
+
 void uniform2(GLint id, array<float, 2> fl) {
   glUniform2f(id, fl[0], fl[1]);
   }
@@ -2330,26 +2351,44 @@ transmatrix protect_prod(transmatrix T) {
   return T;
   }
 
+/** time of the last CPU-side update of the raycaster map, and of its texture upload, in microseconds */
+EX int map_build_us, map_upload_us;
+/** number of full and incremental map updates so far */
+EX int map_full_builds, map_incremental_builds;
+
 struct raycast_map {
 
   int saved_frameid;
   int saved_map_version;
   int saved_darken;
   
+  /** cells by their slot id; slots of evicted cells are nullptr until reused */
   vector<cell*> lst;
   map<cell*, int> ids;
+  vector<int> free_slots;
 
   vector<transmatrix> ms;
+  /** size of ms right after the last full build; ms only grows in incremental updates */
+  int base_ms;
 
   int length, per_row, rows, mirror_shift, deg;
 
   vector<array<float, 4>> connections, wallcolor, texturemap, volumetric, portal_connections;
+
+  /** rows which have changed since the last upload; if full_upload is set, everything is uploaded */
+  set<int> dirty_rows;
+  bool full_upload;
+  int uploaded_ms;
+
+  raycast_map() { saved_frameid = saved_map_version = saved_darken = 0; base_ms = 0; rows = 0; full_upload = true; uploaded_ms = 0; }
   
   void apply_shape() {
     length = 4096;
     deg = our_raygen.deg;
     per_row = length / deg;
-    rows = next_p2((isize(lst)+per_row-1) / per_row);  
+    int new_rows = next_p2((isize(lst)+per_row-1) / per_row);
+    if(new_rows != rows) full_upload = true;
+    rows = new_rows;
     int q = length * rows;
     connections.resize(q);
     portal_connections.resize(q);
@@ -2416,7 +2455,7 @@ struct raycast_map {
       }
     }
   
-  void generate_cell_listing(cell *cs) {
+  vector<cell*> list_cells(cell *cs) {
     manual_celllister cl;
     cl.add(cs);
     bool optimize = !isWall3(cs);
@@ -2450,11 +2489,55 @@ struct raycast_map {
         }
       }
     finish:
-    lst = cl.lst;
+    return cl.lst;
+    }
+
+  void generate_cell_listing(cell *cs) {
+    lst = list_cells(cs);
     ids.clear();
+    free_slots.clear();
     for(int i=0; i<isize(lst); i++) ids[lst[i]] = i;
     }
 
+  /** recompute the listing around cs, keeping the slots of cells still in range; returns the slots to regenerate */
+  vector<int> update_cell_listing(cell *cs) {
+    auto nlst = list_cells(cs);
+    set<cell*> in_range(nlst.begin(), nlst.end());
+    vector<cell*> changed;
+    for(int i=0; i<isize(lst); i++) if(lst[i] && !in_range.count(lst[i])) {
+      changed.push_back(lst[i]);
+      ids.erase(lst[i]);
+      lst[i] = nullptr;
+      free_slots.push_back(i);
+      }
+    vector<int> dirty;
+    for(cell *c: nlst) if(!ids.count(c)) {
+      int id;
+      if(free_slots.empty()) id = isize(lst), lst.push_back(c);
+      else id = free_slots.back(), free_slots.pop_back(), lst[id] = c;
+      ids[c] = id;
+      dirty.push_back(id);
+      changed.push_back(c);
+      }
+    /* the neighbors of added and evicted cells now point to different slots; only the cells in range are
+     * walked, as the evicted ones may have been freed */
+    set<cell*> changed_set(changed.begin(), changed.end());
+    set<int> seen(dirty.begin(), dirty.end());
+    for(cell *c: nlst) {
+      int id = ids[c];
+      if(seen.count(id)) continue;
+      forCellEx(c1, c) if(changed_set.count(c1)) { seen.insert(id), dirty.push_back(id); break; }
+      }
+    return dirty;
+    }
+
+  void clear_slot(int id) {
+    int u = (id/per_row*length) + (id%per_row * deg);
+    for(int i=0; i<deg; i++) {
+      connections[u+i] = wallcolor[u+i] = texturemap[u+i] = volumetric[u+i] = portal_connections[u+i] = array<float, 4>{0, 0, 0, 0};
+      }
+    }
+
   array<float, 2> enc(int i, int a) { 
     array<float, 2> res;
     res[0] = ((i%per_row) * deg + a + .5) / length;
@@ -2506,7 +2589,7 @@ struct raycast_map {
         float p = 1 - dv / 16.;
         wallcolor[u] = glhr::acolor(wcol);
         for(int a: {0,1,2}) wallcolor[u][a] *= p;
-        if(qfi.fshape) {
+        if(qfi.fshape && qfi.fshape->id < isize(floor_texture_map)) {
           texturemap[u] = floor_texture_map[qfi.fshape->id];
           }
         else
@@ -2573,7 +2656,7 @@ struct raycast_map {
       dd.set_land_floor(Vf);
       int u = (id/per_row*length) + (id%per_row * deg) + c->type + a;
       wallcolor[u] = glhr::acolor(darkena(dd.fcol, 0, 0xFF));
-      if(qfi.fshape) 
+      if(qfi.fshape && qfi.fshape->id < isize(floor_texture_map))
         texturemap[u] = floor_texture_map[qfi.fshape->id];
       else
         texturemap[u] = glhr::makevertex(0.1,0,0);
@@ -2586,6 +2669,15 @@ struct raycast_map {
     for(cell* c: lst) if(!reset_rmap)
       generate_connections(c, id++);
     }
+
+  void generate_connections(const vector<int>& dirty) {
+    intra::resetter ir;
+    for(int id: dirty) if(!reset_rmap) {
+      clear_slot(id);
+      generate_connections(lst[id], id);
+      dirty_rows.insert(id / per_row);
+      }
+    }
   
   bool gms_exceeded() {
     if(m_via_texture) return false;
@@ -2594,10 +2686,12 @@ struct raycast_map {
 
   void assign_uniforms(raycaster* o) {
     if(!o) return;
+    auto t0 = std::chrono::steady_clock::now();
     glUniform1i(o->uLength, length);
     GLERR("uniform mediump length");
     
-    if(m_via_texture) {
+    if(!full_upload && uploaded_ms == isize(ms)) ;
+    else if(m_via_texture) {
       int mlength = next_p2(isize(ms));
       vector<array<float, 4>> m_map;
       m_map.resize(4 * mlength);
@@ -2615,17 +2709,31 @@ struct raycast_map {
       for(auto& m: ms) gms.push_back(glhr::tmtogl_transpose3(m));
       glUniformMatrix4fv(o->uM, isize(gms), 0, gms[0].as_array());
       }
+    uploaded_ms = isize(ms);
     
-    bind_array(wallcolor, o->tWallcolor, txWallcolor, 4, length);
-    bind_array(connections, o->tConnections, txConnections, 3, length);
-    bind_array(texturemap, o->tTextureMap, txTextureMap, 5, length);
-    if(volumetric::on) bind_array(volumetric, o->tVolumetric, txVolumetric, 6, length);
-    if(o->tPortalConnections != -1)
-      bind_array(portal_connections, o->tPortalConnections, txPortalConnections, 1, length);
+    if(full_upload) {
+      bind_array(wallcolor, o->tWallcolor, txWallcolor, 4, length);
+      bind_array(connections, o->tConnections, txConnections, 3, length);
+      bind_array(texturemap, o->tTextureMap, txTextureMap, 5, length);
+      if(volumetric::on) bind_array(volumetric, o->tVolumetric, txVolumetric, 6, length);
+      if(o->tPortalConnections != -1)
+        bind_array(portal_connections, o->tPortalConnections, txPortalConnections, 1, length);
+      }
+    else {
+      update_array_rows(wallcolor, o->tWallcolor, txWallcolor, 4, length, dirty_rows);
+      update_array_rows(connections, o->tConnections, txConnections, 3, length, dirty_rows);
+      update_array_rows(texturemap, o->tTextureMap, txTextureMap, 5, length, dirty_rows);
+      if(volumetric::on) update_array_rows(volumetric, o->tVolumetric, txVolumetric, 6, length, dirty_rows);
+      if(o->tPortalConnections != -1)
+        update_array_rows(portal_connections, o->tPortalConnections, txPortalConnections, 1, length, dirty_rows);
+      }
+    full_upload = false;
+    dirty_rows.clear();
 
     if(o->uMirrorShift != -1) {
       glUniform1i(o->uMirrorShift, mirror_shift);
       }
+    map_upload_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
     }
   
   void create_all(cell *cs) {
@@ -2636,6 +2744,35 @@ struct raycast_map {
     generate_cell_listing(cs);
     apply_shape();
     generate_connections();
+    base_ms = isize(ms);
+    full_upload = true;
+    dirty_rows.clear();
+    map_full_builds++;
+    }
+
+  /** bring the map up to date around cs, reusing the slots of cells which stay in range */
+  void update(cell *cs) {
+    PROFILE("raycaster map");
+    auto t0 = std::chrono::steady_clock::now();
+    bool full = lst.empty() || darken != saved_darken || intra::in || isize(ms) > 2 * base_ms + 64;
+    if(full) create_all(cs);
+    else {
+      bool all_rows = saved_map_version != mapeditor::map_version || (!fixed_map && frameid != saved_frameid);
+      saved_frameid = frameid;
+      saved_map_version = mapeditor::map_version;
+      auto dirty = update_cell_listing(cs);
+      int old_rows = rows;
+      apply_shape();
+      /* connections encode the slot ids using rows, so they all change with it */
+      if(rows != old_rows) all_rows = true;
+      if(all_rows) {
+        dirty.clear();
+        for(int i=0; i<isize(lst); i++) if(lst[i]) dirty.push_back(i);
+        }
+      generate_connections(dirty);
+      map_incremental_builds++;
+      }
+    map_build_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
     }
   
   bool need_to_create(cell *cs) {
@@ -2896,7 +3033,7 @@ EX void cast() {
   if(!rmap) rmap = (unique_ptr<raycast_map>) new raycast_map;
   
   if(rmap->need_to_create(cs)) {
-    rmap->create_all(cs);  
+    rmap->update(cs);
     if(reset_rmap) {
       reset_raycaster();
       cast();
@@ -3044,6 +3181,316 @@ EX void cast() {
   GLERR("finish");
   }
 
+/** \brief a CPU implementation of the raycaster
+ *
+ *  It consumes the same raycast_map tables as the shader, and can be used without a GPU
+ *  (e.g. with -nogui) to render reference frames and to benchmark. Only the isotropic
+ *  3D geometries without portals, horospheres and mirrors are supported.
+ */
+EX namespace cpu {
+
+/** the number of threads to use; 0 = hardware concurrency */
+EX int threads = 0;
+
+/** the size of the square tiles the image is split into */
+EX int tile_size = 32;
+
+typedef array<float, 4> fvec;
+struct fmat { fvec row[4]; };
+
+inline fvec operator * (const fmat& M, const fvec& h) {
+  fvec res;
+  for(int a=0; a<4; a++) res[a] = M.row[a][0] * h[0] + M.row[a][1] * h[1] + M.row[a][2] * h[2] + M.row[a][3] * h[3];
+  return res;
+  }
+
+inline fmat operator * (const fmat& A, const fmat& B) {
+  fmat res;
+  for(int a=0; a<4; a++) for(int b=0; b<4; b++)
+    res.row[a][b] = A.row[a][0] * B.row[0][b] + A.row[a][1] * B.row[1][b] + A.row[a][2] * B.row[2][b] + A.row[a][3] * B.row[3][b];
+  return res;
+  }
+
+inline fvec lincomb(const fvec& h1, float a, const fvec& h2, float b) {
+  fvec res;
+  for(int i=0; i<4; i++) res[i] = h1[i] * a + h2[i] * b;
+  return res;
+  }
+
+inline float dot4(const fvec& h1, const fvec& h2) { return h1[0]*h2[0] + h1[1]*h2[1] + h1[2]*h2[2] + h1[3]*h2[3]; }
+
+fmat to_fmat(const transmatrix& T) {
+  fmat res;
+  for(int a=0; a<4; a++) for(int b=0; b<4; b++) res.row[a][b] = T[a][b];
+  return res;
+  }
+
+/** everything a ray needs to know, prepared on the main thread */
+struct scene {
+  raycast_map *m;
+  vector<fmat> ms;
+  vector<fvec> wallx, wally;
+  vector<int> wallstart;
+  fmat start;
+  int start_base, start_walloffset, start_sides;
+  bool many_cell_types;
+  bool use_sides;
+  float linear_sightrange, exp_start, exp_decay, hard_limit, tanfov;
+  fvec fog;
+  int max_iter;
+  };
+
+EX bool supported() {
+  return WDIM == 3 && GDIM == 3 && (hyperbolic || sphere || euclid) && !gproduct && !nonisotropic && !is_stepbased()
+    && !intra::in && !bt::in() && !stretch::in() && !is_eyes() && !reg3::ultra_mirror_in() && !volumetric::on && !reflect_val;
+  }
+
+/** prepare the scene as seen from the current view; returns false if not possible */
+bool prepare(scene& sc) {
+  if(!supported()) {
+    println(hlog, "CPU raycaster: geometry not supported");
+    return false;
+    }
+  cell *cs = centerover;
+  if(!cs) return false;
+  currentmap->wall_offset(cs);
+  our_raygen.deg = sample_degree();
+
+  transmatrix T = inverse(cview().T);
+  virtualRebase(cs, T);
+  transmatrix msm = stretch::mstretch_matrix;
+  rayfix(cs, T, msm);
+
+  for(int attempt=0; attempt<2; attempt++) {
+    if(reset_rmap) rmap = nullptr, reset_rmap = false;
+    if(!rmap) rmap = (unique_ptr<raycast_map>) new raycast_map;
+    if(rmap->need_to_create(cs)) rmap->update(cs);
+    if(!reset_rmap) break;
+    }
+  if(reset_rmap || !rmap->ids.count(cs)) return false;
+
+  auto& m = *rmap;
+  sc.m = &m;
+  sc.ms.clear();
+  for(auto& M: m.ms) sc.ms.push_back(to_fmat(M));
+
+  vector<glvertex> wallx, wally;
+  vector<GLint> wallstart;
+  vector<GLfloat> wallangle;
+  load_walls(wallx, wally, wallstart, wallangle);
+  sc.wallx.clear(); sc.wally.clear();
+  for(auto& w: wallx) sc.wallx.push_back(fvec{w[0], w[1], w[2], w[3]});
+  for(auto& w: wally) sc.wally.push_back(fvec{w[0], w[1], w[2], w[3]});
+  sc.wallstart.assign(wallstart.begin(), wallstart.end());
+
+  sc.start = to_fmat(T);
+  int sid = m.ids[cs];
+  sc.start_base = (sid / m.per_row * m.length) + (sid % m.per_row * m.deg);
+  sc.start_walloffset = intra::full_wall_offset(cs);
+  sc.start_sides = cs->type;
+  sc.many_cell_types = need_many_cell_types();
+  sc.use_sides = is_subcube_based(variation) || geometry == gOctTet3;
+  sc.linear_sightrange = sightranges[geometry];
+  sc.exp_start = exp_start;
+  sc.exp_decay = exp_decay_current();
+  sc.hard_limit = hard_limit;
+  ld fov = vid.fov * degree / 2;
+  sc.tanfov = tan(fov);
+  auto cols = glhr::acolor(darkena(backcolor, 0, 0xFF));
+  sc.fog = fvec{cols[0], cols[1], cols[2], cols[3]};
+  sc.max_iter = max_iter_current();
+  return true;
+  }
+
+fvec map_texture(const scene& sc, const fvec& pos, int which) {
+  int s = sc.wallstart[which], e = sc.wallstart[which+1];
+  for(int i=s; i<e && i<s+16; i++) {
+    float vx = dot4(sc.wallx[i], pos), vy = dot4(sc.wally[i], pos);
+    if(vx >= 0 && vy >= 0 && vx + vy <= 1) return fvec{vx+vy, vx-vy, 0, 0};
+    }
+  return fvec{1, 1, 0, 0};
+  }
+
+/** trace a single ray in direction at0 (in the camera coordinates); the same algorithm as the shader */
+color_t trace(const scene& sc, const fvec& at0) {
+  auto& m = *sc.m;
+  fvec position = sc.start * fvec{0, 0, 0, 1};
+  fvec tangent = sc.start * at0;
+  fvec out = {0, 0, 0, 1};
+  float left = 1, go = 0;
+  int base = sc.start_base, walloffset = sc.start_walloffset, sides = sc.start_sides;
+
+  auto finish = [&] {
+    color_t res = 0xFF000000;
+    for(int p=0; p<3; p++) part(res, 2-p) = int(255 * max(0.f, min(1.f, out[p])) + .5);
+    return res;
+    };
+
+  for(int iter=0; iter<sc.max_iter; iter++) {
+    float dist = 100;
+    int which = -1;
+    int lim = sc.use_sides ? sides : m.deg;
+    for(int i=0; i<lim; i++) {
+      const fmat& M = sc.ms[walloffset+i];
+      fvec mp = M * position, mt = M * tangent;
+      float d;
+      if(hyperbolic) {
+        float v = (position[3] - mp[3]) / (mt[3] - tangent[3]);
+        if(v > 1 || v < -1) continue;
+        d = atanh(v);
+        fvec next_tangent = lincomb(position, sinh(d), tangent, cosh(d));
+        if(next_tangent[3] < (M * next_tangent)[3]) continue;
+        }
+      else if(sphere) {
+        float v = (position[3] - mp[3]) / (mt[3] - tangent[3]);
+        d = atan(v);
+        fvec next_tangent = lincomb(position, -sin(d), tangent, cos(d));
+        if(next_tangent[3] > (M * next_tangent)[3]) continue;
+        }
+      else {
+        float deno = dot4(position, tangent) - dot4(mp, mt);
+        if(deno < 1e-6 && deno > -1e-6) continue;
+        d = (dot4(mp, mp) - dot4(position, position)) / 2 / deno;
+        if(d < 0) continue;
+        fvec next_position = lincomb(position, 1, tangent, d);
+        if(dot4(next_position, tangent) < dot4(M * next_position, mt)) continue;
+        }
+      if(d < dist) { dist = d; which = i; }
+      }
+
+    if(dist < 0) dist = 0;
+    if(which == -1 && dist == 0) return finish();
+
+    if(hyperbolic) {
+      float ch = cosh(dist), sh = sinh(dist);
+      fvec v = lincomb(position, ch, tangent, sh);
+      tangent = lincomb(tangent, ch, position, sh);
+      position = v;
+      float pn = sqrt(position[3]*position[3] - position[0]*position[0] - position[1]*position[1] - position[2]*position[2]);
+      for(auto& x: position) x /= pn;
+      float tp = -position[0]*tangent[0] - position[1]*tangent[1] - position[2]*tangent[2] + position[3]*tangent[3];
+      tangent = lincomb(tangent, 1, position, -tp);
+      float tn = sqrt(tangent[0]*tangent[0] + tangent[1]*tangent[1] + tangent[2]*tangent[2] - tangent[3]*tangent[3]);
+      for(auto& x: tangent) x /= tn;
+      }
+    else if(sphere) {
+      float ch = cos(dist), sh = sin(dist);
+      fvec v = lincomb(position, ch, tangent, sh);
+      tangent = lincomb(tangent, ch, position, -sh);
+      position = v;
+      }
+    else
+      position = lincomb(position, 1, tangent, dist);
+
+    go += dist;
+    if(which == -1) continue;
+
+    int u = base + which;
+    fvec col = m.wallcolor[u];
+    if(col[3] > 0) {
+      if(go > sc.hard_limit) return finish();
+      fvec pos = position;
+      if(!euclid) for(auto& x: pos) x /= position[3];
+      fvec inface = map_texture(sc, pos, which + walloffset);
+      const fvec& tmap = m.texturemap[u];
+      if(tmap[2] == 0 && tmap[0] != 0) {
+        float f = min(1.f, (1 - inface[0]) / tmap[0]);
+        for(int p=0; p<3; p++) col[p] *= f;
+        }
+      float d = max(1 - go / sc.linear_sightrange, sc.exp_start * exp(-go / sc.exp_decay));
+      for(int p=0; p<3; p++) col[p] = col[p] * d + sc.fog[p] * (1-d);
+      for(int p=0; p<3; p++) out[p] += left * col[p] * col[3];
+      if(col[3] >= 1) return finish();
+      left *= (1 - col[3]);
+      }
+
+    const fvec& connection = m.connections[u];
+    base = int(connection[1] * m.rows) * m.length + int(connection[0] * m.length);
+    int mid = int(connection[2] * 1024);
+    if(mid < 0 || mid >= isize(sc.ms)) return finish();
+    fmat M = sc.ms[mid] * sc.ms[walloffset + which];
+    position = M * position;
+    tangent = M * tangent;
+
+    if(sc.many_cell_types) {
+      int nwalloffset = int(connection[3] * max_wall_offset);
+      sides = int(connection[3] * max_wall_offset * max_celltype) - max_celltype * nwalloffset;
+      walloffset = nwalloffset;
+      }
+    }
+
+  for(int p=0; p<3; p++) out[p] += left * sc.fog[p];
+  return finish();
+  }
+
+/** render a W x H image into out, tiled across threads */
+void render(const scene& sc, int W, int H, vector<color_t>& out) {
+  out.resize(W * H);
+  int ts = max(tile_size, 1);
+  int tx = (W + ts - 1) / ts, ty = (H + ts - 1) / ts;
+  float ax = sc.tanfov, ay = sc.tanfov * H / W;
+
+  auto render_tile = [&] (int t) {
+    int x0 = (t % tx) * ts, y0 = (t / tx) * ts;
+    for(int y=y0; y<min(y0+ts, H); y++)
+    for(int x=x0; x<min(x0+ts, W); x++) {
+      fvec at0 = {(2 * (x + .5f) / W - 1) * ax, (2 * (y + .5f) / H - 1) * ay, 1, 0};
+      float len = sqrt(at0[0]*at0[0] + at0[1]*at0[1] + 1);
+      for(int i=0; i<3; i++) at0[i] /= len;
+      out[y * W + x] = trace(sc, at0);
+      }
+    };
+
+  #if CAP_THREAD
+  int nt = min(threads ? threads : jobs::pool_size(), jobs::pool_size());
+  std::atomic<int> next_tile(0);
+  jobs::parallel_for(nt, [&] (int) {
+    while(true) {
+      int t = next_tile++;
+      if(t >= tx * ty) return;
+      render_tile(t);
+      }
+    }, nt);
+  #else
+  for(int t=0; t<tx*ty; t++) render_tile(t);
+  #endif
+  }
+
+#if CAP_SDL
+/** render the current view to an image file */
+EX bool render_to_file(int W, int H, const string& fname) {
+  scene sc;
+  if(!prepare(sc)) return false;
+  vector<color_t> pixels;
+  render(sc, W, H, pixels);
+  SDL_Surface *sur = SDL_CreateRGBSurface(SDL_SWSURFACE, W, H, 32, 0, 0, 0, 0);
+  if(!sur) return false;
+  for(int y=0; y<H; y++) for(int x=0; x<W; x++) qpixel(sur, x, y) = pixels[y * W + x];
+  IMAGESAVE(sur, fname.c_str());
+  SDL_DestroySurface(sur);
+  println(hlog, "CPU raycaster: saved ", fname);
+  return true;
+  }
+#endif
+
+/** render the current view the given number of times and report the speed */
+EX void benchmark(int W, int H, int frames) {
+  scene sc;
+  auto t0 = std::chrono::steady_clock::now();
+  if(!prepare(sc)) return;
+  auto t1 = std::chrono::steady_clock::now();
+  vector<color_t> pixels;
+  for(int i=0; i<frames; i++) render(sc, W, H, pixels);
+  auto t2 = std::chrono::steady_clock::now();
+  ld prep = std::chrono::duration<ld>(t1 - t0).count();
+  ld rend = std::chrono::duration<ld>(t2 - t1).count();
+  println(hlog, "CPU raycaster: ", full_geometry_name(), ", ", isize(rmap->ids), " cells, map build ", fts(prep * 1000), " ms");
+  println(hlog, "CPU raycaster: ", frames, " frames of ", W, "x", H, " in ", fts(rend), " s, ",
+    fts(rend > 0 ? frames * W * H / rend / 1e6 : 0), " Mrays/s, ", fts(rend > 0 ? frames / rend : 0), " fps");
+  }
+
+EX }
+
 EX namespace volumetric {
 
 EX bool on;
@@ -3215,6 +3662,12 @@ EX void configure() {
     });
 
   dialog::addBoolItem_action(XLAT("the map is fixed (improves performance)"), ray::fixed_map, 'F');
+
+  if(ray::in_use) {
+    dialog::addSelItem(XLAT("map build time"), fts(map_build_us / 1000.) + " ms", 0);
+    dialog::addSelItem(XLAT("map upload time"), fts(map_upload_us / 1000.) + " ms", 0);
+    dialog::addSelItem(XLAT("full/incremental map builds"), its(map_full_builds) + "/" + its(map_incremental_builds), 0);
+    }
   
   if(gms_array_size > gms_limit && ray::in_use) {
     dialog::addBreak(100);
@@ -3289,6 +3742,27 @@ int readArgs() {
     rays_generate = false;
     max_cells = argi();
     }
+  else if(argis("-ray-cpu")) {
+    PHASEFROM(3);
+    start_game();
+    shift(); int W = argi();
+    shift(); int H = argi();
+    shift();
+    #if CAP_SDL
+    cpu::render_to_file(W, H, args());
+    #endif
+    }
+  else if(argis("-ray-cpu-bench")) {
+    PHASEFROM(3);
+    start_game();
+    shift(); int W = argi();
+    shift(); int H = argi();
+    shift(); cpu::benchmark(W, H, argi());
+    }
+  else if(argis("-ray-cpu-threads")) {
+    PHASEFROM(2);
+    shift(); cpu::threads = argi();
+    }
   else if(argis("-ray-random")) {
     start_game();
     shift(); volumetric::intensity = argi();
@@ -3304,7 +3778,11 @@ int readArgs() {
   }
 
 auto hook = addHook(hooks_args, 100, readArgs)
- + addHook(hooks_clearmemory, 40, [] { rmap = {}; });
+ + addHook(hooks_clearmemory, 40, [] { rmap = {}; })
+ /* the incremental updates keep the cells between the frames, so rebuild if any of them is gone */
+ + addHook(hooks_removecells, 40, [] {
+   if(rmap) for(cell *c: rmap->lst) if(c && is_cell_removed(c)) { rmap = {}; return; }
+   });
 #endif
 
 #if CAP_CONFIG
@@ -293,14 +293,11 @@ template<class T> auto parallelize(long long N, T action) -> decltype(action(0,0
   return action(0,N);
 #else
   if(threads == 1) return action(0,N);
-  std::vector<std::thread> v;
   typedef decltype(action(0,0)) Res;
   std::vector<Res> results(threads);
-  for(int k=0; k<threads; k++)
-    v.emplace_back([&,k] () { 
-      results[k] = action(N*k/threads, N*(k+1)/threads); 
-      });
-  for(std::thread& t:v) t.join();
+  jobs::parallel_for(threads, [&] (int k) {
+    results[k] = action(N*k/threads, N*(k+1)/threads);
+    }, threads);
   Res res = 0;
   for(Res r: results) res += r;
   return res;
@@ -333,9 +330,7 @@ void build_disttable_approx() {
   using namespace rogueviz;
 
   std::vector<vector<array<ll, 2>>> results(threads);
-  std::vector<std::thread> v;
-  for(int k=0; k<threads; k++)
-    v.emplace_back([&,k] () {
+  jobs::parallel_for(threads, [&] (int k) {
       auto& dt = results[k];
       vector<int> tab(N, N);
       auto p = k ? nullptr : new progressbar(N/threads, "build_disttable_approx");
@@ -355,8 +350,7 @@ void build_disttable_approx() {
           }
         }
       if(p) delete p;
-      });
-  for(std::thread& t:v) t.join();
+      }, threads);
   
   int mx = 0;
   for(auto& r: results) mx = max(mx, isize(r));
@@ -94,6 +94,7 @@ bool unsafeLand(cell *c) {
   }
 
 EX void save_memory() {
+  PROFILE("save_memory");
   if(quotient || !hyperbolic || NONSTDVAR) return;
   if(!memory_saving_mode) return;
   if(unsafeLand(cwt.at)) return;
@@ -22,14 +22,20 @@ EX always_false in;
 #endif
 
 #if CAP_SVG
-  #if ISWEB
+  /** texts and circles are printed here; polygons are collected in elements and formatted on flush() */
   shstream f;
-  #else
-  fhstream f;
-  #endif
   
   EX bool in = false;
 
+  /** write a gzip-compressed file (svgz); also used when the file name ends with .svgz */
+  EX bool compressed = false;
+
+  /** the number of threads used to format polygons, 0 = all the hardware threads */
+  EX int threads = 0;
+
+  /** the number of polygons collected before they are formatted and written */
+  EX int chunk_size = 16384;
+
   EX bool remove_out = true;
   
   ld cta(color_t col) {
@@ -63,10 +69,10 @@ EX always_false in;
       }
     }
   
-  char* stylestr(color_t fill, color_t stroke, ld width=1) {
+  /** buf should have room for 600 characters; thread-safe */
+  void format_style(char *buf, color_t fill, color_t stroke, ld width) {
     fixgamma(fill);
     fixgamma(stroke);
-    static char buf[600];
     // printf("fill = %08X stroke = %08x\n", fill, stroke);
   
     if(stroke == 0xFF00FF && false) {
@@ -83,8 +89,33 @@ EX always_false in;
       width/divby,
       (fill>>8) & 0xFFFFFF, cta(fill)
       );
+    }
+
+  char* stylestr(color_t fill, color_t stroke, ld width=1) {
+    static char buf[600];
+    format_style(buf, fill, stroke, width);
     return buf;
     }
+
+  /** the same as coord(val), but faster and thread-safe */
+  void append_coord(string& out, int val) {
+    int decimals = divby == 1 ? 0 : divby <= 10 ? 1 : 2;
+    long long scaled = decimals ? llround(val * (decimals == 1 ? 10. : 100.) / divby) : val;
+    char buf[32];
+    char *end = buf + 32, *p = end;
+    bool neg = scaled < 0;
+    if(neg) scaled = -scaled;
+    int digits = 0;
+    do {
+      if(decimals && digits == decimals) *--p = '.';
+      *--p = '0' + scaled % 10;
+      scaled /= 10;
+      digits++;
+      }
+    while(scaled || digits <= decimals);
+    if(neg) *--p = '-';
+    out.append(p, end - p);
+    }
   
   EX void circle(int x, int y, int size, color_t col, color_t fillcol, double linewidth) {
     if(!invisible(col) || !invisible(fillcol)) {
@@ -152,6 +183,29 @@ EX always_false in;
       }
     }
   
+  /** a polygon to output, and the texts printed to f before it */
+  struct element {
+    string prefix;
+    int start, qty;
+    color_t col, outline;
+    ld width;
+    string link;
+    };
+
+  vector<element> elements;
+  vector<int> element_coords;
+
+  #if ISWEB
+  string web_output;
+  #else
+  FILE *file;
+  #if CAP_ZLIB
+  gzFile gz;
+  #endif
+  #endif
+
+  void flush();
+
   EX void polygon(int *polyx, int *polyy, int polyi, color_t col, color_t outline, double linewidth) {
   
     if(invisible(col) && invisible(outline)) return;
@@ -165,28 +219,94 @@ EX always_false in;
       if(maxx < 0 || maxy < 0 || minx > vid.xres || miny > vid.yres) return;
       }
 
-    startstring();
-    for(int i=0; i<polyi; i++) {
-      if(i == 0)
-        print(f, "<path d=\"M ");
-      else
-        print(f, " L ");
-      print(f, coord(polyx[i]), " ", coord(polyy[i]));
+    elements.emplace_back();
+    auto& e = elements.back();
+    swap(e.prefix, f.s);
+    e.start = isize(element_coords);
+    e.qty = polyi;
+    for(int i=0; i<polyi; i++) element_coords.push_back(polyx[i]), element_coords.push_back(polyy[i]);
+    e.col = col;
+    e.outline = outline;
+    e.width = (hyperbolic ? current_display->radius : current_display->scrsize) * linewidth/256;
+    e.link = link;
+    if(isize(elements) >= chunk_size) flush();
+    }
+
+  void format_element(string& out, const element& e) {
+    out += e.prefix;
+    if(!e.qty) return;
+    if(e.link != "") out += "<a xlink:href=\"" + e.link + "\" xlink:show=\"replace\">";
+    const int *c = &element_coords[e.start];
+    for(int i=0; i<e.qty; i++) {
+      out += i ? " L " : "<path d=\"M ";
+      append_coord(out, c[2*i]);
+      out += ' ';
+      append_coord(out, c[2*i+1]);
       }
-    
-    print(f, "\" ", stylestr(col, outline, (hyperbolic ? current_display->radius : current_display->scrsize) * linewidth/256), "/>");
-    stopstring();
-    println(f);
+    char buf[600];
+    format_style(buf, e.col, e.outline, e.width);
+    out += "\" ";
+    out += buf;
+    out += "/>";
+    if(e.link != "") out += "</a>";
+    out += '\n';
+    }
+
+  void write_out(const string& s) {
+    if(s.empty()) return;
+    #if ISWEB
+    web_output += s;
+    #else
+    #if CAP_ZLIB
+    if(gz) { gzwrite(gz, s.data(), isize(s)); return; }
+    #endif
+    if(file) fwrite(s.data(), isize(s), 1, file);
+    #endif
+    }
+
+  /** format the collected polygons in parallel (each thread formats a contiguous range into its own buffer), and write the buffers in order */
+  void flush() {
+    if(!f.s.empty()) {
+      elements.emplace_back();
+      swap(elements.back().prefix, f.s);
+      }
+    int n = isize(elements);
+    if(!n) return;
+    int nt = n < 256 ? 1 : min(threads ? threads : jobs::pool_size(), jobs::pool_size());
+    vector<string> buffers(nt);
+    /* one contiguous range per buffer, so that the output keeps the order */
+    jobs::parallel_for(nt, [&] (int k) {
+      for(int i=n*k/nt; i<n*(k+1)/nt; i++) format_element(buffers[k], elements[i]);
+      }, nt);
+    for(auto& b: buffers) write_out(b);
+    elements.clear();
+    element_coords.clear();
     }
   
   EX void render(const string& fname, const function<void()>& what IS(shot::default_screenshot_content)) {
     dynamicval<bool> v2(in, true);
     dynamicval<bool> v3(vid.usingGL, false);
     
-    #if ISWEB
     f.s = "";
+    #if ISWEB
+    web_output = "";
     #else
-    f.f = fopen(fname.c_str(), "wt");
+    file = NULL;
+    #if CAP_ZLIB
+    gz = NULL;
+    if(compressed || (isize(fname) > 5 && fname.substr(isize(fname) - 5) == ".svgz"))
+      gz = gzopen(fname.c_str(), "wb");
+    else
+    #endif
+      file = fopen(fname.c_str(), "wt");
+    #if CAP_ZLIB
+    if(!file && !gz) {
+    #else
+    if(!file) {
+    #endif
+      println(hlog, "failed to open ", fname);
+      return;
+      }
     #endif
 
     println(f, "<svg xmlns=\"http://www.w3.org/2000/svg\" xmlns:xlink=\"http://www.w3.org/1999/xlink\" width=\"", coord(vid.xres), "\" height=\"", coord(vid.yres), "\">");
@@ -194,6 +314,7 @@ EX always_false in;
       println(f, "<rect width=\"", coord(vid.xres), "\" height=\"", coord(vid.yres), "\" ", stylestr((backcolor << 8) | 0xFF, 0, 0), "/>");
     what();
     println(f, "</svg>");
+    flush();
     
     #if ISWEB
     EM_ASM_({
@@ -201,9 +322,12 @@ EX always_false in;
       x.document.open();
       x.document.write(UTF8ToString($0));
       x.document.close();
-      }, f.s.c_str());
+      }, web_output.c_str());
     #else
-    fclose(f.f); f.f = NULL;
+    #if CAP_ZLIB
+    if(gz) { gzclose(gz); gz = NULL; }
+    #endif
+    if(file) { fclose(file); file = NULL; }
     #endif
     }
 
@@ -237,6 +361,12 @@ int read_args() {
   else if(argis("-svgmt")) {
     shift(); svg::min_text = argi();
     }
+  else if(argis("-svgz")) {
+    shift(); svg::compressed = argi();
+    }
+  else if(argis("-svg-threads")) {
+    shift(); svg::threads = argi();
+    }
   else return 1;
   return 0;
   }
@@ -249,6 +379,7 @@ auto ah2 = addHook(hooks_configfile, 100, [] {
   param_i(shot::shoty, "shoty");
   param_enum(shot::format, "shotsvg", shot::png);
   param_b(shot::transparent, "shottransparent");
+  param_b(svg::compressed, "shotsvgz");
   param_f(shot::gamma, "shotgamma");
   param_str(shot::caption, "shotcaption");
   param_f(shot::fade, "shotfade");
@@ -937,6 +1068,9 @@ EX string format_name() {
   }
 
 EX string format_extension() {
+  #if CAP_SVG && CAP_ZLIB
+  if(format == screenshot_format::svg && svg::compressed) return ".svgz";
+  #endif
   if(format == screenshot_format::svg) return ".svg";
   if(format == screenshot_format::wrl) return ".wrl";
   if(format == screenshot_format::png) return ".png";
@@ -988,6 +1122,9 @@ EX void menu() {
       using namespace svg;
       dialog::addSelItem(XLAT("precision"), "1/"+its(divby), 'p');
       dialog::add_action([] { divby *= 10; if(divby > 1000000) divby = 1; });
+      #if CAP_ZLIB
+      dialog::addBoolItem_action(XLAT("compressed (svgz)"), compressed, 'z');
+      #endif
       #endif
       
       if(models::is_3d(vpconf) || rug::rugged) {
@@ -1407,17 +1544,15 @@ EX bool record_animation_of(reaction_t content) {
     int newticks = i * period / noframes;
     if(time_formula != "-") {
       dynamicval<int> t(ticks, newticks);
-      exp_parser ep;
-      ep.s = time_formula;
       try {
-        newticks = ep.iparse();
+        newticks = parseint(time_formula);
         }
       catch(hr_parse_exception& e) {
         println(hlog, "warning: failed to parse time_formula, ", e.s);
         }
       }
     cmode = (env_shmup ? sm::NORMAL : 0);
-    while(ticks < newticks) shmup::turn(1), ticks++;
+    if(ticks < newticks) shmup::simulate(newticks - ticks);
     if(cheater && numturns) {
       int nturn = numturns * i / noframes;
       if(nturn != oldturn) monstersTurn();
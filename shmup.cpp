@@ -2592,6 +2592,35 @@ EX int pvp_delay = 2000;
 EX int count_pauses;
 EX bool in_pause;
 
+/** \brief the longest step of simulate(), in ms; 1 = tick by tick, as the game does */
+EX int ff_step = 1;
+
+/** \brief during fast-forward, steps are longer than 1 ms only if no monster is closer to a player than this (in the units of SCALE) */
+EX ld ff_margin = 3;
+
+/** \brief did the last turn end with nothing in flight and no monster close to a player */
+bool last_turn_quiet;
+
+/** \brief the number of steps taken by simulate() */
+int sim_steps;
+
+bool check_quiet() {
+  for(int i=0; i<players; i++) if(pc[i]->vel) return false;
+  for(monster *m: active) {
+    if(m->dead || m->type == moPlayer) continue;
+    switch(m->type) {
+      case moBullet: case moFlailBullet: case moFireball: case moTongue: case moAirball:
+      case moArrowTrap: case moCrushball:
+        return false;
+      default: ;
+      }
+    if(m->isVirtual) continue;
+    for(int i=0; i<players; i++)
+      if(hdist(pc[i]->pat*C0, m->pat*C0) < ff_margin * SCALE) return false;
+    }
+  return true;
+  }
+
 EX void turn(int delta) {
 
   if(split_screen && subscreens::split( [delta] () { turn(delta); })) return;
@@ -2854,6 +2883,8 @@ EX void turn(int delta) {
   for(monster *m: additional) 
     active.push_back(m);
   additional.clear();
+
+  last_turn_quiet = check_quiet();
   
   if(delayed_safety) { 
     activateSafety(delayed_safety_land);
@@ -2874,6 +2905,40 @@ EX void turn(int delta) {
   active.clear();
   }
 
+/** \brief advance the game by ms milliseconds, advancing ticks too
+ *
+ *  While nothing can collide (see check_quiet), the steps are up to ff_step ms long, but they never
+ *  pass the once-per-second and dragon moves, so these happen at the same curtime as tick by tick.
+ *  With ff_step = 1 this is exactly the same as calling turn(1) for every tick.
+ */
+EX void simulate(int ms) {
+  while(ms > 0) {
+    int step = 1;
+    if(ff_step > 1 && last_turn_quiet) {
+      step = min(ff_step, ms);
+      if(nextmove > curtime) step = min(step, nextmove - curtime);
+      if((havewhat&HF_DRAGON) && nextdragon > curtime) step = min(step, nextdragon - curtime);
+      }
+    turn(step);
+    ticks += step;
+    sim_steps++;
+    ms -= step;
+    }
+  }
+
+/** \brief simulate the given number of seconds of the current game, and print how fast it was */
+EX void benchmark(int seconds) {
+  if(!on) { println(hlog, "shmup: the benchmark needs the shmup mode"); return; }
+  dynamicval<int> cm(cmode, sm::NORMAL);
+  dynamicval<bool> of(outoffocus, false);
+  dynamicval<int> t(ticks, ticks);
+  int steps0 = sim_steps;
+  auto t0 = std::chrono::steady_clock::now();
+  for(int s=0; s<seconds; s++) simulate(1000);
+  ld wall = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count() / 1e6;
+  println(hlog, "shmup: simulated ", seconds, " s in ", fts(wall, 4), " s (", fts(seconds / wall, 4), " simulated s per s), ", sim_steps - steps0, " steps, ff_step = ", ff_step);
+  }
+
 EX void recall() {
   for(int i=0; i<players; i++) {
     pc[i]->base = cwt.at;
@@ -3015,6 +3080,26 @@ auto hooks = addHook(hooks_clearmemory, 0, shmup::clearMemory) +
       }
     });
 
+auto hooks_ff = addHook(hooks_configfile, 100, [] {
+    param_i(ff_step, "shmup_ff_step", 1)
+    ->editable(1, 200, 5, "fast-forward step (ms)", "When recording animations of the shmup mode, simulate up to this many milliseconds at once while nothing can collide. 1 = tick by tick, which gives exactly the same results as the game.", 'f');
+    })
+#if CAP_COMMANDLINE
+  + addHook(hooks_args, 100, [] {
+    using namespace arg;
+    if(0) ;
+    else if(argis("-shmup-ff")) {
+      shift(); ff_step = max(argi(), 1);
+      }
+    else if(argis("-shmup-bench")) {
+      shift(); benchmark(argi());
+      }
+    else return 1;
+    return 0;
+    })
+#endif
+  ;
+
 EX void switch_shmup() { 
   stop_game();
   switch_game_mode(rg::shmup);
@@ -27,14 +27,19 @@ EX int effvolume = 60;
 EX bool music_available;
 EX int musiclength[MUSIC_MAX];
 
-EX eLand getCurrentLandForMusic() {
-  eLand id = ((anims::center_music()) && centerover) ? centerover->land : cwt.at->land;
+/** \brief the land whose music is played in land id */
+EX eLand music_land(eLand id) {
   if(isHaunted(id)) id = laHaunted;
   if(id == laWarpSea) id = laWarpCoast;
   if(id == laMercuryRiver) id = laTerracotta;
   return id;
   }
 
+EX eLand getCurrentLandForMusic() {
+  eLand id = ((anims::center_music()) && centerover) ? centerover->land : cwt.at->land;
+  return music_land(id);
+  }
+
 EX void playSeenSound(cell *c) {
   if(!c->monst) return;
   bool nearme = c->cpdist <= 7;
@@ -89,6 +94,8 @@ EX void playSeenSound(cell *c) {
 #if CAP_SDLAUDIO
 
 bool loaded[MUSIC_MAX];
+/** \brief the music has been requested from the loader, but it has not arrived yet */
+bool music_loading[MUSIC_MAX];
 Mix_Music* music[MUSIC_MAX];
 EX int musicpos[MUSIC_MAX];
 EX int musstart;
@@ -101,30 +108,194 @@ EX hookset<void(eLand&)> hooks_sync_music;
 
 EX bool music_out_of_focus = false;
 
+/** \brief the sound effects kept in memory, in megabytes */
+EX int sound_cache_limit = 64;
+
+struct sound_chunk {
+  Mix_Chunk *chunk;
+  /** SDL_GetTicks() at the last use, to free the least recently used chunks first */
+  int last_used;
+  };
+
+map<string, sound_chunk> chunks;
+long long chunk_bytes;
+
+/** \brief music and sound effects are decoded in a separate thread, so that entering a new land does not stall the frame */
+struct audio_loader {
+  struct job { bool is_music; int id; string name; string path; };
+  struct result { job j; void *data; };
+
+  result run(const job& j) {
+    void *data = j.is_music ? (void*) Mix_LoadMUS(j.path.c_str()) : (void*) Mix_LoadWAV(j.path.c_str());
+    if(!data) printf("%s: %s\n", j.is_music ? "Mix_LoadMUS" : "Mix_LoadWAV", Mix_GetError());
+    return result{j, data};
+    }
+
+  #if CAP_THREAD
+  std::mutex lock;
+  std::condition_variable cv;
+  std::deque<job> jobs;
+  vector<result> done;
+  bool finished = false;
+  std::thread worker;
+
+  /** urgent jobs (what is needed right now) go before the prefetched ones */
+  void request(const job& j, bool urgent) {
+    std::unique_lock<std::mutex> lk(lock);
+    if(finished) return;
+    if(!worker.joinable()) worker = std::thread([this] {
+      std::unique_lock<std::mutex> lk(lock);
+      while(true) {
+        cv.wait(lk, [this] { return finished || !jobs.empty(); });
+        if(finished) return;
+        job j = jobs.front(); jobs.pop_front();
+        lk.unlock();
+        auto r = run(j);
+        lk.lock();
+        done.push_back(r);
+        }
+      });
+    if(urgent) jobs.push_front(j); else jobs.push_back(j);
+    cv.notify_all();
+    }
+
+  void collect(vector<result>& out) {
+    std::unique_lock<std::mutex> lk(lock);
+    swap(out, done);
+    }
+
+  void finish() {
+    { std::unique_lock<std::mutex> lk(lock); finished = true; jobs.clear(); cv.notify_all(); }
+    if(worker.joinable()) worker.join();
+    }
+  #else
+  vector<result> done;
+  void request(const job& j, bool urgent) { done.push_back(run(j)); }
+  void collect(vector<result>& out) { swap(out, done); }
+  void finish() {}
+  #endif
+  };
+
+audio_loader loader;
+
+set<string> chunks_loading;
+
+/** \brief sounds requested before their chunk was loaded; they are played if it arrives soon enough */
+struct delayed_sound { string fname; int vol; int requested; };
+vector<delayed_sound> delayed_sounds;
+
+/** \brief a sound which has to wait longer than this (in ms) is skipped */
+constexpr int SOUND_DELAY_LIMIT = 250;
+
+void play_chunk(Mix_Chunk *chunk, int vol) {
+  Mix_VolumeChunk(chunk, effvolume * vol / 100);
+  Mix_PlayChannel(-1, chunk, 0);
+  }
+
+/** \brief free the least recently used chunks which are not playing, until the cache fits in sound_cache_limit */
+void trim_chunks() {
+  while(chunk_bytes > sound_cache_limit * 1048576ll) {
+    set<Mix_Chunk*> currently_played;
+    for(int ch=0; ch<16; ch++) if(Mix_Playing(ch)) currently_played.insert(Mix_GetChunk(ch));
+    auto lru = chunks.end();
+    for(auto it = chunks.begin(); it != chunks.end(); it++)
+      if(it->second.chunk && !currently_played.count(it->second.chunk) && (lru == chunks.end() || it->second.last_used < lru->second.last_used))
+        lru = it;
+    if(lru == chunks.end()) return;
+    chunk_bytes -= lru->second.chunk->alen;
+    Mix_FreeChunk(lru->second.chunk);
+    chunks.erase(lru);
+    }
+  }
+
+/** \brief take the music and the chunks the loader has finished */
+void collect_loaded() {
+  vector<audio_loader::result> res;
+  loader.collect(res);
+  for(auto& r: res) {
+    if(r.j.is_music) {
+      auto mus = (Mix_Music*) r.data;
+      bool used = false;
+      for(int i=0; i<MUSIC_MAX; i++) if(music_loading[i] && musfname[i] == r.j.path) {
+        music_loading[i] = false;
+        if(!music[i]) music[i] = mus, used = true;
+        }
+      if(mus && !used) Mix_FreeMusic(mus);
+      }
+    else {
+      chunks_loading.erase(r.j.name);
+      auto chunk = (Mix_Chunk*) r.data;
+      chunks[r.j.name] = sound_chunk{chunk, int(SDL_GetTicks())};
+      if(chunk) chunk_bytes += chunk->alen;
+      for(auto& d: delayed_sounds) if(d.fname == r.j.name) {
+        if(chunk && int(SDL_GetTicks()) - d.requested < SOUND_DELAY_LIMIT) play_chunk(chunk, d.vol);
+        d.requested = INT_MIN;
+        }
+      trim_chunks();
+      }
+    }
+  int now = SDL_GetTicks();
+  delayed_sounds.erase(remove_if(delayed_sounds.begin(), delayed_sounds.end(), [now] (const delayed_sound& d) { return d.requested == INT_MIN || now - d.requested >= SOUND_DELAY_LIMIT; }), delayed_sounds.end());
+  }
+
+/** \brief make sure that the music for id is loaded or being loaded */
+void request_music(int id, bool urgent) {
+  if(loaded[id] || memory_issues()) return;
+  loaded[id] = true;
+  if(musfname[id] == "") return;
+  // reuse music, or wait for the same file which is being loaded already
+  for(int i=0; i<MUSIC_MAX; i++)
+    if(loaded[i] && i != id && musfname[i] == musfname[id]) {
+      music[id] = music[i];
+      music_loading[id] = music_loading[i];
+      return;
+      }
+  memory_for_lib();
+  music_loading[id] = true;
+  loader.request(audio_loader::job{true, id, "", musfname[id]}, urgent);
+  }
+
+/** \brief make sure that the sound effect fname is loaded or being loaded */
+bool request_sound(const string& fname, bool urgent) {
+  if(chunks.count(fname) || chunks_loading.count(fname)) return true;
+  if(memory_issues()) return false;
+  memory_for_lib();
+  chunks_loading.insert(fname);
+  loader.request(audio_loader::job{false, 0, fname, find_file(wheresounds + fname + ".ogg")}, urgent);
+  return true;
+  }
+
+/** \brief the sounds loaded when the audio is initialized */
+const vector<string> common_sounds = { "click", "hit-sword", "hit-axe", "fire", "hit-crush", "splash", "pickup-orb", "orb-ranged" };
+
+int prefetched_turn = -1;
+eLand prefetched_land = laNone;
+
+/** \brief load the music of the lands close to the player, so that it is ready when the player enters them */
+void prefetch_music(eLand id) {
+  if(prefetched_turn == turncount && prefetched_land == id) return;
+  prefetched_turn = turncount; prefetched_land = id;
+  if(memory_issues()) return;
+  int checked = 0;
+  for(cell *c: dcal) {
+    if(c->cpdist > 7 || checked++ > 1000) break;
+    eLand l = music_land(c->land);
+    if(l != id && l >= 0 && l < MUSIC_MAX && musfname[l] != "LAST") request_music(l, false);
+    }
+  }
+
 EX void handlemusic() {
   DEBBI(DF_GRAPH, ("handle music"));
+  collect_loaded();
   if(audio && musicvolume) {
     eLand id = getCurrentLandForMusic();
     if(callhandlers(false, hooks_music, id)) return;
     if(outoffocus && !music_out_of_focus) id = eLand(0);
     if(musfname[id] == "LAST") id = cid;
-    if(!loaded[id] && !memory_issues()) {
-      loaded[id] = true;
-      // printf("loading (%d)> %s\n", id, musfname[id].c_str());      
-      // reuse music
-      if(musfname[id] != "") {
-        for(int i=0; i<landtypes; i++)
-          if(music[i] && musfname[i] == musfname[id])
-            music[id] = music[i];
-        }
-      if(!music[id]) {
-        memory_for_lib();
-        music[id] = Mix_LoadMUS(musfname[id].c_str());
-        if(!music[id]) {
-           printf("Mix_LoadMUS: %s\n", Mix_GetError());
-           }
-        }
-      }
+    request_music(id, true);
+    prefetch_music(id);
+    /* keep playing the current music until the new one is loaded */
+    if(music_loading[id] && cid != laNone) return;
     if(cid != id && !musfadeval) {
       musicpos[cid] = SDL_GetTicks() - musstart;
       musfadeval = musicpos[id] ? 500 : 2000;
@@ -221,12 +392,11 @@ EX void initAudio() {
     else {
       audio = true;
       Mix_AllocateChannels(16);
+      for(auto& s: common_sounds) request_sound(s, false);
       }
     }
   }
 
-map<string, Mix_Chunk*> chunks;
-
 hookset<bool(const string& s, int vol)> hooks_sound;
 
 EX string wheresounds = "sounds/";
@@ -236,18 +406,14 @@ EX void playSound(cell *c, const string& fname, int vol) {
   if(effvolume == 0) return;
   if(callhandlers(false, hooks_sound, fname, vol)) return;
   // printf("Play sound: %s\n", fname.c_str());
+  collect_loaded();
   if(!chunks.count(fname)) {
-    string s = find_file(wheresounds + fname + ".ogg");
-    if(memory_issues()) return;
-    memory_for_lib();
-    chunks[fname] = Mix_LoadWAV(s.c_str());
-    // printf("Loading, as %p\n", chunks[fname]);
-    }
-  Mix_Chunk *chunk = chunks[fname];
-  if(chunk) {
-    Mix_VolumeChunk(chunk, effvolume * vol / 100);
-    Mix_PlayChannel(-1, chunk, 0);
+    if(request_sound(fname, true)) delayed_sounds.push_back(delayed_sound{fname, vol, int(SDL_GetTicks())});
+    return;
     }
+  auto& sc = chunks[fname];
+  sc.last_used = SDL_GetTicks();
+  if(sc.chunk) play_chunk(sc.chunk, vol);
   }
 
 EX void reuse_music_memory() {
@@ -259,18 +425,20 @@ EX void reuse_music_memory() {
       for(int j=0; j<landtypes; j++) if(music[j] == which) {
         println(hlog, "... which equals ", dnameof(eLand(j)));
         music[j] = NULL;
+        loaded[j] = false;
         }
       }
   set<Mix_Chunk*> currently_played;
   for(int ch=0; ch<16; ch++) currently_played.insert(Mix_GetChunk(ch));
   set<string> to_free;
   for(auto& p: chunks) 
-    if(p.second) {
-      if(currently_played.count(p.second)) {
+    if(p.second.chunk) {
+      if(currently_played.count(p.second.chunk)) {
         println(hlog, p.first, ": currently played");
         }
       else {
-        Mix_FreeChunk(p.second);
+        chunk_bytes -= p.second.chunk->alen;
+        Mix_FreeChunk(p.second.chunk);
         to_free.insert(p.first); 
         println(hlog, p.first, ": freed");
         }
@@ -278,6 +446,11 @@ EX void reuse_music_memory() {
   for(auto& s: to_free) chunks.erase(s);
   }
 
+/** \brief stop the loader thread; called before the audio is shut down, as it may be decoding a file */
+EX void stop_audio_loader() { loader.finish(); }
+
+auto ah_loader = addHook(hooks_final_cleanup, 100, stop_audio_loader);
+
 #endif
 
 #if CAP_COMMANDLINE
@@ -622,6 +622,7 @@ typedef unsigned GLuint;
 #include <random>
 #include <complex>
 #include <new>
+#include <chrono>
 #include <limits.h>
 
 #if CAP_VR
@@ -211,6 +211,8 @@ EX void initgame() {
     firstland = safetyland;
     }
 
+  init_rng_streams();
+
   if(!safety) {
     firstland = specialland;
     ineligible_starting_land = !landUnlockedIngame(specialland);
@@ -1239,6 +1241,134 @@ EX void saveStats(bool emergency IS(false)) {
 
 bool tamper = false;
 
+/** \brief use the score file index (see read_score_index) */
+EX bool use_score_index = true;
+
+constexpr int SCORE_INDEX_MAGIC = 0x58495248;
+constexpr int SCORE_INDEX_FORMAT = 1;
+/** \brief how many bytes at the start, and before the indexed position, are compared */
+constexpr long long SCORE_INDEX_CHECKED = 16384;
+
+string score_index_file() { return scorefile + ".idx"; }
+
+unsigned long long fnv_hash(const char *s, size_t q, unsigned long long h = 0xcbf29ce484222325ull) {
+  while(q--) h = (h ^ (unsigned char) *(s++)) * 0x100000001b3ull;
+  return h;
+  }
+
+/** \brief hash of the bytes of the score file which must not change for the index to be valid; 0 if it cannot be read */
+unsigned long long score_file_hash(long long scanned) {
+  FILE *f = fopen(scorefile.c_str(), "rb");
+  if(!f) return 0;
+  unsigned long long h = 0xcbf29ce484222325ull;
+  auto hash_range = [&] (long long from, long long to) {
+    if(fseek(f, from, SEEK_SET)) return false;
+    char buf[4096];
+    while(from < to) {
+      int q = fread(buf, 1, min<long long>(to - from, sizeof(buf)), f);
+      if(q <= 0) return false;
+      h = fnv_hash(buf, q, h);
+      from += q;
+      }
+    return true;
+    };
+  bool ok = fseek(f, 0, SEEK_END) == 0 && ftell(f) >= scanned;
+  ok = ok && hash_range(0, min(scanned, SCORE_INDEX_CHECKED));
+  ok = ok && hash_range(max(0ll, scanned - SCORE_INDEX_CHECKED), scanned);
+  /* the index must end at a line boundary */
+  ok = ok && scanned > 0 && fseek(f, scanned-1, SEEK_SET) == 0 && fgetc(f) == '\n';
+  fclose(f);
+  return ok ? (h ? h : 1) : 0;
+  }
+
+void write_score_header(hstream& f) {
+  hwrite(f, SCORE_INDEX_MAGIC, SCORE_INDEX_FORMAT, int(VERNUM_HEX), int(MAXBOX), int(ittypes), int(landtypes), save_cheats);
+  }
+
+/** \brief save everything loadsave has computed from the first `scanned` bytes of the score file */
+void write_score_index(long long scanned, bool ok) {
+  unsigned long long fh = score_file_hash(scanned);
+  if(!fh) return;
+
+  shstream body;
+  hwrite(body, ok, tamper, scores::boxid, scores::saved_modecode, scorebox.ver);
+  for(int i=0; i<MAXBOX; i++) hwrite(body, scorebox.box[i], scores::save.box[i]);
+  write_mode_tables(body);
+  hwrite(body, hiitems);
+  tactic::write_records(body);
+  hwrite(body, yendor::bestscore);
+  #if CAP_RACING
+  hwrite(body, racing::best_scores);
+  #endif
+  hwrite(body, princess::everSaved, yendor::everwon, chaosUnlocked);
+  int coh = counthints();
+  hwrite(body, coh);
+  for(int i=0; i<coh; i++) hwrite(body, (long long) hints[i].last);
+
+  string fname = score_index_file();
+  string tmp = fname + ".tmp";
+  try {
+    fhstream f(tmp, "wb");
+    if(!f.f) return;
+    write_score_header(f);
+    hwrite(f, scanned, fh, fnv_hash(body.s.c_str(), body.s.size()), body.s);
+    }
+  catch(hstream_exception&) { remove(tmp.c_str()); return; }
+  remove(fname.c_str());
+  if(rename(tmp.c_str(), fname.c_str())) remove(tmp.c_str());
+  DEBB(DF_INIT, ("score index saved at ", std::to_string(scanned)));
+  }
+
+/** \brief restore the state saved by write_score_index, if still valid for the score file
+ *  \return the position in the score file to continue from, or -1 if the file has to be scanned from the start
+ */
+long long read_score_index(bool& ok) {
+  string data;
+  FILE *f = fopen(score_index_file().c_str(), "rb");
+  if(!f) return -1;
+  char buf[4096];
+  while(true) {
+    int q = fread(buf, 1, sizeof(buf), f);
+    if(q <= 0) break;
+    data.append(buf, q);
+    }
+  fclose(f);
+
+  long long scanned;
+  shstream body;
+  try {
+    shstream ss(data);
+    shstream expected;
+    write_score_header(expected);
+    if(data.compare(0, expected.s.size(), expected.s)) return -1;
+    ss.pos = isize(expected.s);
+    unsigned long long fh, bh;
+    hread(ss, scanned, fh, bh, body.s);
+    if(fnv_hash(body.s.c_str(), body.s.size()) != bh) return -1;
+    if(score_file_hash(scanned) != fh) return -1;
+    }
+  catch(hstream_exception&) { return -1; }
+
+  /* the body is known to be what write_score_index wrote, so it parses */
+  hread(body, ok, tamper, scores::boxid, scores::saved_modecode, scorebox.ver);
+  for(int i=0; i<MAXBOX; i++) hread(body, scorebox.box[i], scores::save.box[i]);
+  read_mode_tables(body);
+  hread(body, hiitems);
+  tactic::read_records(body);
+  hread(body, yendor::bestscore);
+  #if CAP_RACING
+  hread(body, racing::best_scores);
+  #endif
+  hread(body, princess::everSaved, yendor::everwon, chaosUnlocked);
+  int coh = body.get<int>();
+  for(int i=0; i<coh; i++) {
+    long long last = body.get<long long>();
+    if(i < counthints()) hints[i].last = last;
+    }
+  DEBB(DF_INIT, ("score index valid up to ", std::to_string(scanned)));
+  return scanned;
+  }
+
 // load the save
 EX void loadsave() {
   if(autocheat) return;
@@ -1254,9 +1384,12 @@ EX void loadsave() {
   bool ok = false;
   int coh = counthints();
   auto& sc = scorebox;
+  long long indexed = use_score_index ? read_score_index(ok) : -1;
+  if(indexed > 0) fseek(f, indexed, SEEK_SET);
+  bool at_end = false;
   while(!feof(f)) {
     char buf[12000];
-    if(fgets(buf, 12000, f) == NULL) break;
+    if(fgets(buf, 12000, f) == NULL) { at_end = true; break; }
     if(buf[0] == 'M' && buf[1] == 'O') {
       string s = buf;
       while(s != "" && s.back() < 32) s.pop_back();
@@ -1377,7 +1510,9 @@ EX void loadsave() {
       }
     }
 
+  long long scanned = ftell(f);
   fclose(f);
+  if(use_score_index && at_end && scanned != indexed) write_score_index(scanned, ok);
   // this is the index of Orb of Safety
   if(ok && sc.box[65 + 4 + itOrbSafety - itOrbLightning])
     load_last_save();
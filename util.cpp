@@ -178,6 +178,44 @@ struct exp_parser {
     if(!eat(c)) throw hr_parse_exception("expected: " + string(c) + " at " + where());
     }
 
+  struct compiled_formula compile(const vector<string>& inputs);
+  int compile_node(struct compiled_formula& cf, int prio = 0);
+  int compile_par(struct compiled_formula& cf);
+  int compile_opaque(struct compiled_formula& cf, int start);
+  };
+
+struct parameter;
+
+/** \brief a formula compiled with exp_parser::compile
+ *
+ *  Evaluating it gives the same result as parsing the formula again, but the string is
+ *  parsed only once, and the constant subexpressions are computed during the compilation.
+ *  The given inputs get the slots 0, 1, ..., followed by the extra_params of the parser;
+ *  their values are set directly in slots.
+ */
+struct compiled_formula {
+  struct node {
+    int op;
+    cld val;
+    vector<int> args;
+    int slot;
+    shared_ptr<parameter> par;
+    /** for constructs which are not compiled: the text and the variables visible */
+    string text;
+    vector<pair<string, int>> scope;
+    };
+  vector<node> nodes;
+  int root;
+  /** values of inputs and let-bound variables */
+  vector<cld> slots;
+  /** used during the compilation */
+  vector<pair<string, int>> scope;
+
+  int add(node&& n);
+  cld eval() { return eval(root); }
+  cld eval(int id);
+  ld reval();
+  int ieval() { return int(floor(reval() + .5)); }
   };
 #endif
 
@@ -523,6 +561,408 @@ cld exp_parser::parse(int prio) {
   return res;
   }
 
+enum eFormulaOp { foConst, foSlot, foParam, foVar, foOpaque, foLet, foNeg, foAdd, foSub, foMul, foDiv, foPow, foFunc, foFloor, foFrac, foTo01, foMin, foMax, foAtan2, foIfp, foIfz, foSpline };
+
+static const vector<string> formula_functions = {
+  "sin(", "cos(", "sinh(", "cosh(", "asin(", "acos(", "asinh(", "acosh(", "exp(", "sqrt(",
+  "log(", "tan(", "tanh(", "atan(", "atanh(", "abs(", "re(", "im(", "conj("
+  };
+
+/** variables which change between evaluations, computed natively */
+static const vector<string> formula_variables = {
+  "s", "ms", "mousex", "mousey", "turncount", "framecount", "gametime", "last_a", "last_b", "last_c", "last_d",
+  "holdmouse", "mousexs", "mouseys", "random", "mousez", "shot"
+  };
+
+/** variables which change between evaluations, computed by exp_parser */
+static const vector<string> formula_opaque_variables = {
+  "ultra_mirror_dist", "psl_steps", "single_step", "step", "edgelen", "illegal_moves",
+  "lshift", "rshift", "lctrl", "rctrl", "capslock", "numlock", "scrolllock", "fake_edgelength"
+  };
+
+ld formula_real(cld x) {
+  if(kz(imag(x))) throw hr_parse_exception("expected real number but " + lalign(-1, x) + " found");
+  return real(x);
+  }
+
+cld formula_function(int f, cld x) {
+  switch(f) {
+    case 0: return sin(x);
+    case 1: return cos(x);
+    case 2: return sinh(x);
+    case 3: return cosh(x);
+    case 4: return asin(x);
+    case 5: return acos(x);
+    case 6: return asinh(x);
+    case 7: return acosh(x);
+    case 8: return exp(x);
+    case 9: return sqrt(x);
+    case 10: return log(x);
+    case 11: return tan(x);
+    case 12: return tanh(x);
+    case 13: return atan(x);
+    case 14: return atanh(x);
+    case 15: return abs(x);
+    case 16: return real(x);
+    case 17: return imag(x);
+    case 18: return std::conj(x);
+    }
+  return x;
+  }
+
+cld formula_variable(int v) {
+  switch(v) {
+    case 0: return ticks / 1000.;
+    case 1: return ticks;
+    case 2: return mousex;
+    case 3: return mousey;
+    case 4: return turncount;
+    case 5: return frameid;
+    case 6: return getgametime_precise();
+    case 7: case 8: case 9: case 10: return anims::last_anim_vars[v-7];
+    case 11: return holdmouse ? 1 : 0;
+    case 12:
+      if(!inHighQual) bmousexs = (1. * mousex - current_display->xcenter) / current_display->radius;
+      return bmousexs;
+    case 13:
+      if(!inHighQual) bmouseys = (1. * mousey - current_display->ycenter) / current_display->radius;
+      return bmouseys;
+    case 14: return randd();
+    case 15: return cld(mousex - current_display->xcenter, mousey - current_display->ycenter) / cld(current_display->radius, 0);
+    case 16: return inHighQual ? 1 : 0;
+    }
+  return 0;
+  }
+
+int compiled_formula::add(node&& n) {
+  bool pure = among(n.op, foNeg, foAdd, foSub, foMul, foDiv, foPow, foFunc, foFloor, foFrac, foTo01) || among(n.op, foMin, foMax, foAtan2, foIfp, foIfz);
+  for(int a: n.args) if(nodes[a].op != foConst) pure = false;
+  nodes.emplace_back(std::move(n));
+  int id = isize(nodes) - 1;
+  if(pure) {
+    cld v = eval(id);
+    auto& nn = nodes[id];
+    nn.op = foConst; nn.val = v; nn.args.clear();
+    }
+  return id;
+  }
+
+cld compiled_formula::eval(int id) {
+  auto& n = nodes[id];
+  auto arg = [&] (int i) { return eval(n.args[i]); };
+  switch(n.op) {
+    case foConst: return n.val;
+    case foSlot: return slots[n.slot];
+    case foParam: return n.par->get_cld();
+    case foVar: return formula_variable(n.slot);
+    case foOpaque: {
+      exp_parser ep;
+      ep.s = n.text;
+      for(auto& p: n.scope) ep.extra_params[p.first] = slots[p.second];
+      return ep.parse();
+      }
+    case foLet:
+      slots[n.slot] = arg(0);
+      return arg(1);
+    case foNeg: return -arg(0);
+    case foAdd: { cld a = arg(0); return a + arg(1); }
+    case foSub: { cld a = arg(0); return a - arg(1); }
+    case foMul: { cld a = arg(0); return a * arg(1); }
+    case foDiv: { cld a = arg(0); return a / arg(1); }
+    case foPow: { cld a = arg(0); return pow(a, arg(1)); }
+    case foFunc: return formula_function(n.slot, arg(0));
+    case foFloor: return floor(formula_real(arg(0)));
+    case foFrac: { cld a = arg(0); return a - floor(formula_real(a)); }
+    case foTo01: return atan(arg(0)) / ld(M_PI) + ld(0.5);
+    case foMin: case foMax: {
+      ld a = formula_real(arg(0));
+      for(int i=1; i<isize(n.args); i++) {
+        ld b = formula_real(arg(i));
+        a = n.op == foMin ? min(a, b) : max(a, b);
+        }
+      return a;
+      }
+    case foAtan2: { ld y = formula_real(arg(0)); return atan2(y, formula_real(arg(1))); }
+    case foIfp: { cld c = arg(0), yes = arg(1), no = arg(2); return real(c) > 0 ? yes : no; }
+    case foIfz: { cld c = arg(0), yes = arg(1), no = arg(2); return abs(c) < 1e-8 ? yes : no; }
+    #if CAP_ANIMATIONS
+    case foSpline: {
+      /* the same as the spline interpolation in exp_parser::parse; -1 is NO_DERIVATIVE */
+      static const cld NO_DERIVATIVE(3.1, 2.5);
+      vector<int> ids;
+      for(int a: n.args) if(a >= 0) ids.push_back(a);
+      sort(ids.begin(), ids.end());
+      ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+      vector<cld> vals;
+      for(int a: ids) vals.push_back(eval(a));
+      vector<array<cld, 4>> rest(isize(n.args) / 4);
+      for(int i=0; i<isize(n.args); i++) {
+        int a = n.args[i];
+        rest[i/4][i%4] = a < 0 ? NO_DERIVATIVE : vals[std::lower_bound(ids.begin(), ids.end(), a) - ids.begin()];
+        }
+      ld v = ticks * (isize(rest)-1.) / anims::period;
+      int vf = v;
+      v -= vf;
+      if(isize(rest) == 1) rest.push_back(rest[0]);
+      vf %= (isize(rest)-1);
+      auto& lft = rest[vf];
+      auto& rgt = rest[vf+1];
+      if(lft[3] == NO_DERIVATIVE && rgt[1] == NO_DERIVATIVE)
+        return lerp(lft[2], rgt[0], v);
+      else if(rgt[1] == NO_DERIVATIVE)
+        return lerp(lft[2] + lft[3] * v, rgt[0], v*v);
+      else if(lft[3] == NO_DERIVATIVE)
+        return lerp(lft[2], rgt[0] + rgt[1] * (v-1), (2-v)*v);
+      else
+        return lerp(lft[2] + lft[3] * v, rgt[0] + rgt[1] * (v-1), v*v*(3-2*v));
+      }
+    #endif
+    }
+  throw hr_parse_exception("bad compiled formula");
+  }
+
+ld compiled_formula::reval() {
+  return formula_real(eval());
+  }
+
+compiled_formula exp_parser::compile(const vector<string>& inputs) {
+  compiled_formula cf;
+  for(int i=0; i<isize(inputs); i++) {
+    cf.slots.push_back(0);
+    cf.scope.emplace_back(inputs[i], i);
+    }
+  for(auto& p: extra_params) {
+    int slot = isize(cf.slots);
+    cf.slots.push_back(p.second);
+    cf.scope.emplace_back(p.first, slot);
+    }
+  cf.root = compile_node(cf, 0);
+  cf.scope.clear();
+  return cf;
+  }
+
+int exp_parser::compile_par(compiled_formula& cf) {
+  int res = compile_node(cf, 0);
+  force_eat(")");
+  return res;
+  }
+
+/** a construct not handled by the compiler: find its extent, to be evaluated by exp_parser */
+int exp_parser::compile_opaque(compiled_formula& cf, int start) {
+  int depth = 1;
+  while(depth) {
+    if(at >= isize(s)) throw hr_parse_exception("expected: ) at " + where());
+    char c = eatchar();
+    if(c == '(') depth++;
+    if(c == ')') depth--;
+    }
+  compiled_formula::node n;
+  n.op = foOpaque;
+  n.text = s.substr(start, at - start);
+  n.scope = cf.scope;
+  return cf.add(std::move(n));
+  }
+
+/** mirrors exp_parser::parse, but builds a compiled_formula instead of computing the value */
+int exp_parser::compile_node(compiled_formula& cf, int prio) {
+  using node = compiled_formula::node;
+  auto mk = [&] (int op, vector<int> args, int slot = 0) {
+    node n;
+    n.op = op; n.args = std::move(args); n.slot = slot;
+    return cf.add(std::move(n));
+    };
+  auto mkconst = [&] (cld val) {
+    node n;
+    n.op = foConst; n.val = val;
+    return cf.add(std::move(n));
+    };
+  int res;
+  skip_white();
+  int start = at;
+  int fid = -1;
+  for(int i=0; i<isize(formula_functions); i++) if(eat(formula_functions[i].c_str())) { fid = i; break; }
+  if(fid >= 0) res = mk(foFunc, {compile_par(cf)}, fid);
+  else if(eat("floor(")) res = mk(foFloor, {compile_par(cf)});
+  else if(eat("frac(")) res = mk(foFrac, {compile_par(cf)});
+  else if(eat("to01(")) return mk(foTo01, {compile_par(cf)});
+  else if(eat("min(") || eat("max(")) {
+    int op = s[start+1] == 'i' ? foMin : foMax;
+    vector<int> args = {compile_node(cf, 0)};
+    while(skip_white(), eat(",")) args.push_back(compile_node(cf, 0));
+    force_eat(")");
+    res = mk(op, args);
+    }
+  else if(eat("atan2(")) {
+    int y = compile_node(cf, 0);
+    force_eat(",");
+    int x = compile_par(cf);
+    res = mk(foAtan2, {y, x});
+    }
+  else if(eat("edge(")) res = compile_opaque(cf, start);
+  else if(eat("edge_angles(")) return compile_opaque(cf, start);
+  else if(eat("regradius(")) res = compile_opaque(cf, start);
+  #if CAP_ARCM
+  else if(eat("arcmedge(") || eat("arcmcurv(")) res = compile_opaque(cf, start);
+  #endif
+  else if(eat("ideal_angle(") || eat("ideal_edge(")) return compile_opaque(cf, start);
+  else if(eat("regangle(") || eat("test(")) res = compile_opaque(cf, start);
+  else if(eat("ifp(") || eat("ifz(")) {
+    int op = s[start+2] == 'p' ? foIfp : foIfz;
+    int cond = compile_node(cf, 0);
+    force_eat(",");
+    int yes = compile_node(cf, 0);
+    force_eat(",");
+    int no = compile_par(cf);
+    res = mk(op, {cond, yes, no});
+    }
+  else if(eat("let(")) {
+    string name = next_token();
+    force_eat("=");
+    int val = compile_node(cf, 0);
+    force_eat(",");
+    int slot = isize(cf.slots);
+    cf.slots.push_back(0);
+    cf.scope.emplace_back(name, slot);
+    int body = compile_par(cf);
+    cf.scope.pop_back();
+    res = mk(foLet, {val, body}, slot);
+    }
+  #if CAP_TEXTURE
+  else if(eat("txp(")) res = compile_opaque(cf, start);
+  #endif
+  else if(eat("lands_at(")) return compile_opaque(cf, start);
+  else if(next() == '(') at++, res = compile_par(cf);
+  else {
+    string number = next_token();
+    int slot = -1;
+    for(auto& p: cf.scope) if(p.first == number) slot = p.second;
+    auto find = [&] (const vector<string>& v) { for(int i=0; i<isize(v); i++) if(v[i] == number) return i; return -1; };
+    if(slot >= 0) res = mk(foSlot, {}, slot);
+    else if (auto *p = hr::at_or_null(params, number)) {
+      node n;
+      n.op = foParam; n.par = *p;
+      res = cf.add(std::move(n));
+      }
+    else if(number == "e") res = mkconst(exp(1));
+    else if(number == "i") res = mkconst(cld(0, 1));
+    else if(number == "inf") res = mkconst(HUGE_VAL);
+    else if(number == "p" || number == "pi") res = mkconst(M_PI);
+    else if(number == "tau") res = mkconst(TAU);
+    else if(number == "phi") res = mkconst((1 + sqrt(5)) / 2);
+    else if(number == "" && next() == '-') { at++; res = mk(foNeg, {compile_node(cf, 20)}); }
+    else if(number == "") throw hr_parse_exception("number missing, " + where());
+    else if(find(formula_variables) >= 0) res = mk(foVar, {}, find(formula_variables));
+    else if(number[0] == '0' && number[1] == 'x') res = mkconst(strtoll(number.c_str()+2, NULL, 16));
+    else if(number == "deg") res = mkconst(degree);
+    else if(number == "MAX_EDGE") res = mkconst(FULL_EDGE);
+    else if(number == "MAX_VALENCE") res = mkconst(120);
+    else if(find(formula_opaque_variables) >= 0) {
+      node n;
+      n.op = foOpaque; n.text = number; n.scope = cf.scope;
+      res = cf.add(std::move(n));
+      }
+    else if(number[0] >= 'a' && number[0] <= 'z') throw hr_parse_exception("unknown value: " + number);
+    else if(number[0] >= 'A' && number[0] <= 'Z') throw hr_parse_exception("unknown value: " + number);
+    else if(number[0] == '_') throw hr_parse_exception("unknown value: " + number);
+    else {
+      if(among(number.back(), 'e', 'E')) {
+        if(eat("-")) number = number + "-" + next_token();
+        else if(eat("+")) number = number + "+" + next_token();
+        }
+      std::stringstream ss; cld val = 0; ss << number;
+      ss >> val;
+      if(ss.fail() || !ss.eof()) throw hr_parse_exception("unknown value: " + number);
+      res = mkconst(val);
+      }
+    }
+  while(true) {
+    skip_white();
+    #if CAP_ANIMATIONS
+    if(next() == '.' && next(1) == '.' && prio == 0) {
+      vector<array<int, 4>> rest = { make_array(res, -1, res, -1) };
+      bool second = true;
+      while(next() == '.' && next(1) == '.') {
+        if(next(2) == '/') {
+          at += 3;
+          rest.back()[second ? 3 : 1] = compile_node(cf, 10);
+          continue;
+          }
+        else if(next(2) == '|') {
+          at += 3;
+          rest.back()[2] = compile_node(cf, 10);
+          rest.back()[3] = -1;
+          second = true;
+          continue;
+          }
+        at += 2;
+        int val = compile_node(cf, 10);
+        rest.emplace_back(make_array(val, -1, val, -1));
+        second = false;
+        }
+      vector<int> args;
+      for(auto& r: rest) for(int a: r) args.push_back(a);
+      return mk(foSpline, args);
+      }
+    else
+    #endif
+    if(next() == '+' && prio <= 10) at++, res = mk(foAdd, {res, compile_node(cf, 20)});
+    else if(next() == '-' && prio <= 10) at++, res = mk(foSub, {res, compile_node(cf, 20)});
+    else if(next() == '*' && prio <= 20) at++, res = mk(foMul, {res, compile_node(cf, 30)});
+    else if(next() == '/' && prio <= 20) at++, res = mk(foDiv, {res, compile_node(cf, 30)});
+    else if(next() == '^') at++, res = mk(foPow, {res, compile_node(cf, 40)});
+    else break;
+    }
+  return res;
+  }
+
+/** per thread, as evaluating a compiled_formula writes to its slots */
+thread_local map<string, shared_ptr<compiled_formula>> formula_cache;
+thread_local int formula_cache_params = -1;
+
+/** compile s with the given inputs (which get the slots 0, 1, ...), or reuse an earlier compilation of this thread */
+EX shared_ptr<compiled_formula> cached_formula(const string& s, const vector<string>& inputs IS(vector<string>())) {
+  if(formula_cache_params != isize(params) || isize(formula_cache) >= 4096) {
+    formula_cache.clear();
+    formula_cache_params = isize(params);
+    }
+  string key = s;
+  for(auto& i: inputs) key += '\0' + i;
+  auto& res = formula_cache[key];
+  if(!res) {
+    try {
+      exp_parser ep;
+      ep.s = s;
+      res = make_shared<compiled_formula>(ep.compile(inputs));
+      }
+    catch(hr_parse_exception&) {
+      formula_cache.erase(key);
+      throw;
+      }
+    }
+  return res;
+  }
+
+/** compare the speed of parsing and of the compiled formula */
+EX void formula_benchmark(const string& s, int n) {
+  cld total = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for(int i=0; i<n; i++) {
+    exp_parser ep;
+    ep.s = s;
+    total += ep.parse();
+    }
+  auto t1 = std::chrono::steady_clock::now();
+  auto cf = cached_formula(s);
+  for(int i=0; i<n; i++) total += cf->eval();
+  auto t2 = std::chrono::steady_clock::now();
+  double a = std::chrono::duration<double>(t1 - t0).count();
+  double b = std::chrono::duration<double>(t2 - t1).count();
+  println(hlog, "formula: ", s, " (", isize(cf->nodes), " nodes)");
+  println(hlog, "parsed: ", n / a, " evaluations/s");
+  println(hlog, "compiled: ", n / b, " evaluations/s, ", a / b, " times faster");
+  println(hlog, "checksum: ", total);
+  }
+
 int coord_id(char ch) {
   if(ch == 'x') return 0;
   if(ch == 'y') return 1;
@@ -665,9 +1105,7 @@ color_t exp_parser::parsecolor(int prio) {
   }
 
 EX ld parseld(const string& s) {
-  exp_parser ep;
-  ep.s = s;
-  return ep.rparse();
+  return cached_formula(s)->reval();
   }
 
 EX transmatrix parsematrix(const string& s) {
@@ -709,9 +1147,7 @@ EX trans23 parsematrix23(const string& s) {
   }
 
 EX int parseint(const string& s) {
-  exp_parser ep;
-  ep.s = s;
-  return ep.iparse();
+  return cached_formula(s)->ieval();
   }
 
 EX string available_functions() {
@@ -743,6 +1179,8 @@ struct bignum {
   void be(int i) { digits.resize(1); digits[0] = i; }
   bignum& operator +=(const bignum& b);
   void addmul(const bignum& b, int factor);
+  /** this += sum of factor * (*b) over all terms, with a single carry pass; all values and factors must be nonnegative, factors summing to less than 10^10 */
+  void addmul_all(const vector<pair<const bignum*, int>>& terms);
   string get_str(int max_length) const;
   bignum(ld d);
   
@@ -860,7 +1298,7 @@ void bignum::addmul(const bignum& b, int factor) {
     if(i >= isize(digits)) digits.push_back(0);
     long long l = digits[i];
     l += carry;
-    if(i < K) l += b.digits[i] * factor;
+    if(i < K) l += b.digits[i] * (long long) factor;
     carry = 0;
     if(l >= BASE) carry = int(l / BASE);
     if(l < 0) carry = -int((BASE-1-l) / BASE);
@@ -871,6 +1309,23 @@ void bignum::addmul(const bignum& b, int factor) {
   while(isize(digits) && digits.back() == 0) digits.pop_back();
   }
 
+void bignum::addmul_all(const vector<pair<const bignum*, int>>& terms) {
+  int K = isize(digits);
+  for(auto& t: terms) K = max(K, isize(t.first->digits));
+  digits.resize(K);
+  unsigned long long carry = 0;
+  for(int i=0; i<K || carry; i++) {
+    if(i >= isize(digits)) digits.push_back(0);
+    unsigned long long l = carry + digits[i];
+    for(auto& t: terms)
+      if(i < isize(t.first->digits))
+        l += (unsigned long long)(t.first->digits[i]) * t.second;
+    carry = l / BASE;
+    digits[i] = int(l - carry * BASE);
+    }
+  while(isize(digits) && digits.back() == 0) digits.pop_back();
+  }
+
 EX bignum hrand(bignum b) {
   bignum res;
   int d = isize(b.digits);
@@ -283,7 +283,7 @@ EX namespace yendor {
         goto retry;
         }
   
-      auto rollbacks = std::move(changes.rollbacks);
+      int mark = changes.mark();
       for(int i=-1; i<key->type; i++) {
         cell *c2 = i >= 0 ? key->move(i) : key;
         checkTide(c2);
@@ -318,7 +318,7 @@ EX namespace yendor {
         if(c2->land == laMirrorWall && i == -1)
           c2->wall = waNone;
         }
-      changes.rollbacks = std::move(rollbacks);
+      changes.discard_since(mark);
       key->item = itKey;
       
       bool split_found = false;
@@ -794,6 +794,10 @@ EX namespace tactic {
   EX void unrecord() {
     unrecord(lasttactic);
     }
+
+  /** the records loaded from the score file, for the score file index */
+  EX void write_records(hstream& f) { hwrite(f, id, recordsum, lsc); }
+  EX void read_records(hstream& f) { hread(f, id, recordsum, lsc); }
   
   int tscorelast;
 
@@ -1251,6 +1255,10 @@ EX void load_modename_line(string s) {
   modename[get_identify(code)] = s.substr(pos);
   }
 
+/** the mode tables built from the MODE and NAME lines, for the score file index */
+EX void write_mode_tables(hstream& f) { hwrite(f, meaning, code_for, identify_modes, modename, mode_description_of); }
+EX void read_mode_tables(hstream& f) { hread(f, meaning, code_for, identify_modes, modename, mode_description_of); }
+
 EX void update_modename(string newname) {
   modecode();
   string old = modename.count(current_modecode) ? modename[current_modecode] : "";